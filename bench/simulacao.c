@@ -0,0 +1,281 @@
+// muitas transferencias com perda num relogio virtual (simulacao.h): cada par e um emissor
+// e um receptor ligados por um enlace simulado, pelos mesmos enviar/receber com ACK do jogo
+// serve para comparar timeouts, tentativas e politicas de janela em escala, mais rapido que o
+// tempo real e com a mesma execucao para a mesma semente
+// so funciona com a biblioteca de make SIMULACAO=1 (make simula)
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "protocolo.h"
+#include "buffer.h"
+#include "congestionamento.h"
+#include "config.h"
+#include "registro.h"
+#include "latencia.h"
+#include "simulacao.h"
+#include "sorteio.h"
+
+#define TAMANHO_SIM MAX_DADOS
+#define INICIO_MAX_NS 10000000LL // os pares comecam espalhados nos primeiros 10 ms
+#define LIMITE_NS (3600 * 1000000000LL) // uma hora de relogio virtual
+
+typedef struct
+{
+    int sock_emissor, sock_receptor;
+    uchar mac_emissor[6], mac_receptor[6];
+    int falhas;    // transferencias que o emissor nao conseguiu entregar
+    int completas; // transferencias que chegaram inteiras no receptor
+    int errados;   // frames entregues com conteudo trocado
+} Dupla;
+
+static int frames = 1000, transferencias = 1, grupo = 1;
+static Latencias duracoes;
+
+// payload: transferencia e indice do frame, o resto previsivel por eles
+static void preenche(uchar *dados, uint32_t transferencia, uint32_t indice)
+{
+    memcpy(dados, &transferencia, 4);
+    memcpy(dados + 4, &indice, 4);
+    for (int i = 8; i < TAMANHO_SIM; i++)
+        dados[i] = (uchar)(indice * 31 + i);
+}
+
+static int confere(const uchar *dados, uint32_t indice)
+{
+    for (int i = 8; i < TAMANHO_SIM; i++)
+        if (dados[i] != (uchar)(indice * 31 + i))
+            return 0;
+    return 1;
+}
+
+// uma transferencia: os frames um a um ou em grupos pela janela, e o fim (tipo 9)
+static int envia(Dupla *d, uint32_t transferencia, uchar *seq)
+{
+    for (int enviados = 0; enviados < frames;)
+    {
+        BufferFrame *g[JANELA_MAX];
+        int n = grupo < frames - enviados ? grupo : frames - enviados;
+        for (int i = 0; i < n; i++)
+        {
+            if (!(g[i] = buffer_aloca()))
+            {
+                while (i--)
+                    buffer_solta(g[i]);
+                return -1;
+            }
+            *seq = (*seq + 1) % ESPACO_SEQUENCIA;
+            preenche(buffer_dados(g[i]), transferencia, enviados + i);
+            buffer_monta(g[i], *seq, 5, buffer_dados(g[i]), TAMANHO_SIM);
+        }
+        int ret = n == 1 ? enviar_buffer_com_ack(d->sock_emissor, g[0], d->mac_receptor, config.timeout_ms)
+                         : enviar_grupo_com_ack(d->sock_emissor, g, n, NULL, 0, d->mac_receptor, config.timeout_ms);
+        for (int i = 0; i < n; i++)
+            buffer_solta(g[i]);
+        if (ret < 0)
+            return -1;
+        enviados += n;
+    }
+
+    *seq = (*seq + 1) % ESPACO_SEQUENCIA;
+    Frame fim = criar_frame(*seq, 9, (uchar *)&transferencia, 4);
+    return enviar_com_ack(d->sock_emissor, &fim, d->mac_receptor, config.timeout_ms) == 0 ? 0 : -1;
+}
+
+static void emissor(void *arg)
+{
+    Dupla *d = arg;
+    uchar seq = 0;
+    sim_dorme(sorteio_ate(sim_semente(), INICIO_MAX_NS));
+    for (int t = 0; t < transferencias; t++)
+    {
+        long long t0 = timestamp_ns();
+        if (envia(d, t, &seq) != 0)
+            d->falhas++;
+        else
+            latencia_anota(&duracoes, timestamp_ns() - t0);
+    }
+}
+
+// recebe ate o fim da ultima transferencia, ou ate o emissor se calar
+// os repetidos (ACK perdido) sao confirmados de novo e contados uma vez so
+// depois do ultimo fim fica ouvindo por todas as tentativas do emissor, como o TIME_WAIT
+// do TCP: se o ACK do fim se perdeu, o fim repetido ainda recebe o seu
+static void receptor(void *arg)
+{
+    Dupla *d = arg;
+    uint32_t atual = 0;
+    int recebidos = 0, terminou = 0;
+    uchar *visto = calloc(frames, 1);
+    BufferFrame *b;
+
+    while (visto && receber_buffer_com_ack(d->sock_receptor, &b, NULL,
+                                           config.timeout_ms * config.tentativas * (terminou ? 1 : 4)) == 0)
+    {
+        uint32_t t = 0, indice = 0;
+        uchar tipo = buffer_tipo(b);
+        if (buffer_tamanho(b) >= 4)
+            memcpy(&t, buffer_dados(b), 4);
+        if (buffer_tamanho(b) >= 8)
+            memcpy(&indice, buffer_dados(b) + 4, 4);
+        int certo = tipo != 5 || buffer_tamanho(b) != TAMANHO_SIM || confere(buffer_dados(b), indice);
+        buffer_solta(b);
+        if (terminou || (tipo != 5 && tipo != 9) || t < atual)
+            continue;
+        // o emissor desistiu da anterior e seguiu para a proxima
+        if (t > atual)
+        {
+            atual = t;
+            recebidos = 0;
+            memset(visto, 0, frames);
+        }
+        if (tipo == 9)
+        {
+            if (recebidos == frames)
+                d->completas++;
+            if (t + 1 >= (uint32_t)transferencias)
+            {
+                terminou = 1;
+                continue;
+            }
+            atual = t + 1;
+            recebidos = 0;
+            memset(visto, 0, frames);
+        }
+        else if (indice < (uint32_t)frames && !visto[indice])
+        {
+            visto[indice] = 1;
+            recebidos++;
+            if (!certo)
+                d->errados++;
+        }
+    }
+    free(visto);
+}
+
+int main(int argc, char **argv)
+{
+    int pares = 16, variante = CC_AIMD, janela = JANELA_MAX, opt;
+    uint64_t semente = 1;
+    SimEnlace enlace = {100000, 0, 0, 0, 0}; // 100 us de ida, sem limite de taxa
+    int nivel = REG_ERRO;
+    while ((opt = getopt(argc, argv, "n:f:x:g:w:c:t:r:a:j:b:p:e:s:v:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            pares = atoi(optarg);
+            break;
+        case 'f':
+            frames = atoi(optarg);
+            break;
+        case 'x':
+            transferencias = atoi(optarg);
+            break;
+        case 'g':
+            grupo = atoi(optarg);
+            break;
+        case 'w':
+            janela = atoi(optarg);
+            break;
+        case 'c':
+            variante = strcmp(optarg, "atraso") == 0 ? CC_ATRASO : CC_AIMD;
+            break;
+        case 't':
+            config.timeout_ms = atoi(optarg);
+            break;
+        case 'r':
+            config.tentativas = atoi(optarg);
+            break;
+        case 'a':
+            enlace.atraso_ns = atoll(optarg) * 1000;
+            break;
+        case 'j':
+            enlace.variacao_ns = atoll(optarg) * 1000;
+            break;
+        case 'b':
+            enlace.taxa = atof(optarg) * 1e6 / 8;
+            break;
+        case 'p':
+            enlace.perda = atof(optarg) / 100;
+            break;
+        case 'e':
+            enlace.corrupcao = atof(optarg) / 100;
+            break;
+        case 's':
+            semente = strtoull(optarg, NULL, 0);
+            break;
+        case 'v':
+            nivel = registro_nivel_por_nome(optarg);
+            break;
+        default:
+            fprintf(stderr,
+                    "uso: %s [-n pares] [-f frames] [-x transferencias] [-g grupo] [-w janela] [-c aimd|atraso]\n"
+                    "       [-t timeout_ms] [-r tentativas] [-a atraso_us] [-j variacao_us] [-b taxa_mbit]\n"
+                    "       [-p perda%%] [-e corrupcao%%] [-s semente] [-v registro]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+    if (pares < 1 || pares > MAX_PARES / 2 || frames < 1 || transferencias < 1 || grupo < 1 ||
+        grupo > JANELA_MAX || config.timeout_ms < 1 || config.tentativas < 1 || nivel < 0)
+    {
+        fprintf(stderr, "parametros fora dos limites: ate %d pares, grupo ate %d\n", MAX_PARES / 2, JANELA_MAX);
+        return 2;
+    }
+    if (sim_inicia(semente) != 0)
+    {
+        fprintf(stderr, "biblioteca sem os ganchos da simulacao, compile com make SIMULACAO=1\n");
+        return 1;
+    }
+    registro_inicia(nivel);
+    cc_configura(variante, janela);
+
+    Dupla *duplas = calloc(pares, sizeof(Dupla));
+    if (!duplas)
+        return 1;
+    for (int i = 0; i < pares; i++)
+    {
+        Dupla *d = &duplas[i];
+        const uchar emissor_mac[6] = {0x02, 'E', 0, 0, i >> 8, i & 0xff};
+        const uchar receptor_mac[6] = {0x02, 'R', 0, 0, i >> 8, i & 0xff};
+        memcpy(d->mac_emissor, emissor_mac, 6);
+        memcpy(d->mac_receptor, receptor_mac, 6);
+        d->sock_emissor = sim_socket_cria(sim_no(emissor, d), d->mac_emissor);
+        d->sock_receptor = sim_socket_cria(sim_no(receptor, d), d->mac_receptor);
+        sim_liga(d->sock_emissor, d->sock_receptor, &enlace, &enlace);
+    }
+
+    long long t0 = timestamp_ns();
+    int vivos = sim_roda(LIMITE_NS);
+    double real = (timestamp_ns() - t0) / 1e9;
+    double virtual = sim_agora_ns() / 1e9;
+
+    int falhas = 0, completas = 0, errados = 0;
+    for (int i = 0; i < pares; i++)
+    {
+        falhas += duplas[i].falhas;
+        completas += duplas[i].completas;
+        errados += duplas[i].errados;
+    }
+    SimContagem c;
+    sim_contagem(&c);
+    printf("%d pares, %d frames x %d transferencias, grupo %d, perda %.2f%%, corrupcao %.2f%%, semente %llu\n",
+           pares, frames, transferencias, grupo, enlace.perda * 100, enlace.corrupcao * 100,
+           (unsigned long long)semente);
+    printf("relogio virtual %.3f s em %.3f s reais (%.0fx)\n", virtual, real, real > 0 ? virtual / real : 0);
+    printf("frames: %lld enviados, %lld perdidos, %lld corrompidos, %lld entregues, %lld eventos\n", c.enviados,
+           c.perdidos, c.corrompidos, c.entregues, c.eventos);
+    printf("transferencias: %d completas, %d falharam, %d frames errados%s\n", completas, falhas, errados,
+           vivos ? ", simulacao parou no limite" : "");
+    double mediana, p99, maximo;
+    if (latencia_percentis(&duracoes, &mediana, &p99, &maximo))
+        printf("duracao: mediana %.1f ms, p99 %.1f ms, max %.1f ms, %.1f KB/s por par na mediana\n",
+               mediana / 1000, p99 / 1000, maximo / 1000, frames * (double)TAMANHO_SIM / (mediana / 1e6) / 1e3);
+    printf("rastro %016llx\n", (unsigned long long)sim_rastro());
+
+    sim_termina();
+    free(duplas);
+    registro_termina();
+    return errados || vivos ? 1 : 0;
+}
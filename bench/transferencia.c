@@ -0,0 +1,270 @@
+// transferencia sintetica entre dois processos ligados por um socketpair,
+// pelos mesmos caminhos do servidor e do cliente: stop-and-wait e grupos com FEC XOR e RS,
+// e a latencia de ida e volta de frames sem payload, como os movimentos do jogo
+// serve de medida e de treino para o perfil pgo do Makefile
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include "protocolo.h"
+#include "buffer.h"
+#include "fec.h"
+#include "congestionamento.h"
+#include "uring.h"
+#include "config.h"
+#include "giro.h"
+#include "latencia.h"
+
+#define TIMEOUT 200 // ms, nao ha perda real no socketpair
+#define FRAMES 20000
+#define GRUPO 8 // frames de dados por grupo de FEC
+#define IDAS_E_VOLTAS 2000
+
+static const uchar mac_par[6] = {0x02, 0, 0, 0, 0, 0x01};
+
+// payload previsivel pela sequencia, para o receptor conferir ate os frames recuperados
+static void preenche(uchar *dados, uchar seq, int tamanho)
+{
+    for (int i = 0; i < tamanho; i++)
+        dados[i] = (uchar)(seq * 31 + i);
+}
+
+static int confere(BufferFrame *b)
+{
+    const uchar *dados = buffer_dados_c(b);
+    for (int i = 0; i < buffer_tamanho(b); i++)
+        if (dados[i] != (uchar)(buffer_sequencia(b) * 31 + i))
+            return 0;
+    return 1;
+}
+
+// envia 'frames' frames no modo pedido e o fim (tipo 9); retorna -1 se alguma entrega falhou
+static int emissor(int sock, int modo, int frames, uchar *seq)
+{
+    ConfigFEC fec = {modo, GRUPO, 2, 0, 0.0};
+    int tamanho = modo == FEC_DESLIGADO ? MAX_DADOS : FEC_DADOS_POR_FRAME;
+    int ret = 0;
+
+    for (int enviados = 0; enviados < frames && ret == 0;)
+    {
+        BufferFrame *grupo[FEC_MAX_DADOS];
+        BufferFrame *paridades[FEC_MAX_PARIDADE];
+        int n = modo == FEC_DESLIGADO ? 1 : fec.n;
+        if (n > frames - enviados)
+            n = frames - enviados;
+        for (int i = 0; i < n; i++)
+        {
+            grupo[i] = buffer_aloca();
+            *seq = (*seq + 1) % ESPACO_SEQUENCIA;
+            preenche(buffer_dados(grupo[i]), *seq, tamanho);
+            buffer_monta(grupo[i], *seq, 5, buffer_dados(grupo[i]), tamanho);
+        }
+
+        if (modo == FEC_DESLIGADO)
+        {
+            ret = enviar_buffer_com_ack(sock, grupo[0], mac_par, TIMEOUT);
+            buffer_solta(grupo[0]);
+        }
+        else
+        {
+            int k = fec_codifica(&fec, grupo, n, paridades);
+            ret = enviar_grupo_com_ack(sock, grupo, n, paridades, k, mac_par, TIMEOUT) < 0 ? -1 : 0;
+            for (int i = 0; i < n; i++)
+                buffer_solta(grupo[i]);
+            for (int j = 0; j < k; j++)
+                buffer_solta(paridades[j]);
+        }
+        enviados += n;
+    }
+
+    *seq = (*seq + 1) % ESPACO_SEQUENCIA;
+    Frame fim = criar_frame(*seq, 9, NULL, 0);
+    if (enviar_com_ack(sock, &fim, mac_par, TIMEOUT) != 0)
+        ret = -1;
+    return ret;
+}
+
+// envia os frames um por vez e anota quanto cada um levou ate o ACK
+static int idas_e_voltas(int sock, int frames, uchar *seq, Latencias *l)
+{
+    for (int i = 0; i < frames; i++)
+    {
+        *seq = (*seq + 1) % ESPACO_SEQUENCIA;
+        Frame movimento = criar_frame(*seq, 10, NULL, 0);
+        long long t0 = timestamp_ns();
+        if (enviar_com_ack(sock, &movimento, mac_par, TIMEOUT) != 0)
+            return -1;
+        latencia_anota(l, timestamp_ns() - t0);
+    }
+    *seq = (*seq + 1) % ESPACO_SEQUENCIA;
+    Frame fim = criar_frame(*seq, 9, NULL, 0);
+    return enviar_com_ack(sock, &fim, mac_par, TIMEOUT) == 0 ? 0 : -1;
+}
+
+// recebe ate o fim, descartando 'perda'% dos dados depois do ACK para a paridade reconstruir
+// (no maximo um a cada GRUPO frames, o que a paridade XOR sempre recupera)
+// retorna quantos frames de dados chegaram (ou foram recuperados) corretos, -1 se algum veio errado
+static int receptor(int sock, int perda)
+{
+    DecodificadorFEC fec;
+    fec_inicia(&fec);
+    int corretos = 0, errados = 0;
+    int desde_descarte = GRUPO;
+    BufferFrame *b;
+
+    while (receber_buffer_com_ack(sock, &b, NULL, 10 * TIMEOUT) == 0)
+    {
+        uchar tipo = buffer_tipo(b);
+        if (tipo == TIPO_PARIDADE)
+        {
+            BufferFrame *recuperados[FEC_MAX_PARIDADE];
+            int n = fec_recupera(&fec, b, recuperados);
+            for (int i = 0; i < n; i++)
+            {
+                uchar recuperado = 1;
+                Frame ack = criar_frame(buffer_sequencia(recuperados[i]), 0, &recuperado, 1);
+                enviar_frame(sock, &ack, mac_par);
+                confere(recuperados[i]) ? corretos++ : errados++;
+                buffer_solta(recuperados[i]);
+            }
+        }
+        else if (tipo == 5)
+        {
+            if (perda && desde_descarte >= GRUPO && rand() % 100 < perda)
+            {
+                desde_descarte = 0;
+            }
+            else
+            {
+                desde_descarte++;
+                fec_guarda_dados(&fec, b);
+                confere(b) ? corretos++ : errados++;
+            }
+        }
+        buffer_solta(b);
+        if (tipo == 9)
+            break;
+    }
+    fec_termina(&fec);
+    return errados ? -1 : corretos;
+}
+
+int main(int argc, char **argv)
+{
+    int frames = FRAMES, perda = 0, anel = 0, cpu = -1, opt;
+    while ((opt = getopt(argc, argv, "n:p:ug:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            frames = atoi(optarg);
+            break;
+        case 'p':
+            perda = atoi(optarg);
+            break;
+        case 'u':
+            anel = 1;
+            break;
+        case 'g':
+            cpu = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "uso: %s [-n frames] [-p perda%% com FEC] [-u io_uring] [-g cpu do modo de giro]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv) != 0)
+    {
+        perror("Erro ao criar socketpair");
+        return 1;
+    }
+
+    const int modos[] = {FEC_DESLIGADO, FEC_XOR, FEC_RS};
+    const char *nomes[] = {"stop-and-wait", "fec xor", "fec rs"};
+
+    // no modo de giro cada processo fica na sua CPU, o receptor na seguinte;
+    // numa CPU so um giraria em cima do outro, e a medida nao diria nada
+    int cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpu >= 0 && cpus < 2)
+    {
+        printf("modo de giro precisa de duas CPUs, seguindo no modo padrao\n");
+        cpu = -1;
+    }
+    pid_t filho = fork();
+    if (filho == 0)
+    {
+        close(sv[0]);
+        if (cpu >= 0)
+        {
+            config.cpu = (cpu + 1) % cpus;
+            giro_inicia(sv[1]);
+        }
+        if (anel)
+            uring_inicia(sv[1]);
+        int ok = 1;
+        for (int m = 0; m < 3; m++)
+        {
+            int corretos = receptor(sv[1], modos[m] == FEC_DESLIGADO ? 0 : perda);
+            if (corretos != frames)
+            {
+                fprintf(stderr, "%s: %d de %d frames corretos\n", nomes[m], corretos, frames);
+                ok = 0;
+            }
+        }
+        // as idas e voltas nao tem dados, so o fim
+        if (receptor(sv[1], 0) != 0)
+            ok = 0;
+        uring_termina();
+        _exit(ok ? 0 : 1);
+    }
+
+    close(sv[1]);
+    if (cpu >= 0)
+    {
+        config.cpu = cpu % cpus;
+        giro_inicia(sv[0]);
+    }
+    cc_configura(CC_AIMD, JANELA_MAX);
+    if (anel && uring_inicia(sv[0]) != 0)
+        printf("io_uring indisponivel, seguindo com send/recv\n");
+    uchar seq = 0;
+    int ret = 0;
+    for (int m = 0; m < 3; m++)
+    {
+        long long t0 = timestamp_ns();
+        if (emissor(sv[0], modos[m], frames, &seq) != 0)
+        {
+            fprintf(stderr, "%s: falha no envio\n", nomes[m]);
+            ret = 1;
+        }
+        double s = (timestamp_ns() - t0) / 1e9;
+        int tamanho = modos[m] == FEC_DESLIGADO ? MAX_DADOS : FEC_DADOS_POR_FRAME;
+        printf("%-14s %7d frames  %8.3f s  %9.0f frames/s  %6.2f MB/s\n", nomes[m], frames, s,
+               frames / s, frames * (double)tamanho / s / 1e6);
+    }
+
+    static Latencias latencias;
+    double mediana, p99, maximo;
+    if (idas_e_voltas(sv[0], IDAS_E_VOLTAS, &seq, &latencias) != 0)
+    {
+        fprintf(stderr, "idas e voltas: falha no envio\n");
+        ret = 1;
+    }
+    else if (latencia_percentis(&latencias, &mediana, &p99, &maximo))
+    {
+        printf("%-14s %7d frames  mediana %.1f us  p99 %.1f us  max %.1f us  (%s)\n", "ida e volta",
+               IDAS_E_VOLTAS, mediana, p99, maximo, giro_ativo() ? "modo de giro" : "modo padrao");
+    }
+    uring_termina();
+
+    int status;
+    waitpid(filho, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        ret = 1;
+    return ret;
+}
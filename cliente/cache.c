@@ -0,0 +1,197 @@
+#include "cache.h"
+#include "resumo.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// entrada do diretorio, para escolher quem sai quando passa do limite
+typedef struct
+{
+    char nome[NAME_MAX + 1];
+    long long tamanho;
+    struct timespec uso;
+} Entrada;
+
+static char diretorio[128];
+static long long limite; // bytes, 0 desliga o cache
+
+static void caminho_entrada(char *caminho, size_t n, int algoritmo, const uchar *resumo)
+{
+    int k = snprintf(caminho, n, "%s/%s-", diretorio, resumo_nome(algoritmo));
+    for (int i = 0; i < resumo_tamanho(algoritmo) && k + 3 <= (int)n; i++)
+        k += snprintf(caminho + k, n - k, "%02x", resumo[i]);
+}
+
+static int mais_antiga(const void *a, const void *b)
+{
+    const struct timespec *x = &((const Entrada *)a)->uso, *y = &((const Entrada *)b)->uso;
+    if (x->tv_sec != y->tv_sec)
+        return x->tv_sec < y->tv_sec ? -1 : 1;
+    return x->tv_nsec < y->tv_nsec ? -1 : x->tv_nsec > y->tv_nsec;
+}
+
+// apaga as entradas usadas ha mais tempo ate o cache caber no limite
+static void cache_limita(void)
+{
+    DIR *d = opendir(diretorio);
+    if (!d)
+        return;
+
+    Entrada *entradas = NULL;
+    int n = 0, capacidade = 0;
+    long long total = 0;
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL)
+    {
+        // temporarios e "." / ".." comecam com ponto
+        if (e->d_name[0] == '.')
+            continue;
+        char caminho[sizeof(diretorio) + NAME_MAX + 2];
+        struct stat st;
+        snprintf(caminho, sizeof(caminho), "%s/%s", diretorio, e->d_name);
+        if (stat(caminho, &st) != 0 || !S_ISREG(st.st_mode))
+            continue;
+        if (n == capacidade)
+        {
+            capacidade = capacidade ? 2 * capacidade : 64;
+            Entrada *maior = realloc(entradas, capacidade * sizeof(Entrada));
+            if (!maior)
+                break;
+            entradas = maior;
+        }
+        strcpy(entradas[n].nome, e->d_name);
+        entradas[n].tamanho = st.st_size;
+        entradas[n].uso = st.st_mtim;
+        total += st.st_size;
+        n++;
+    }
+    closedir(d);
+
+    qsort(entradas, n, sizeof(Entrada), mais_antiga);
+    for (int i = 0; i < n && total > limite; i++)
+    {
+        char caminho[sizeof(diretorio) + NAME_MAX + 2];
+        snprintf(caminho, sizeof(caminho), "%s/%s", diretorio, entradas[i].nome);
+        if (unlink(caminho) == 0)
+            total -= entradas[i].tamanho;
+    }
+    free(entradas);
+}
+
+// cria o diretorio se preciso e ja aplica o limite, que pode ter diminuido
+// retorna -1 com o cache desligado
+int cache_inicia(const char *dir, int limite_mb)
+{
+    limite = (long long)limite_mb << 20;
+    if (!limite)
+        return -1;
+    if (strlen(dir) >= sizeof(diretorio) || (mkdir(dir, 0755) != 0 && errno != EEXIST))
+    {
+        perror("Erro ao criar o cache");
+        limite = 0;
+        return -1;
+    }
+    strcpy(diretorio, dir);
+    cache_limita();
+    return 0;
+}
+
+// so consulta o diretorio, para responder o anuncio sem atrasar o servidor
+int cache_tem(int algoritmo, const uchar *resumo)
+{
+    if (!limite || algoritmo == RESUMO_NENHUM)
+        return 0;
+    char caminho[256];
+    caminho_entrada(caminho, sizeof(caminho), algoritmo, resumo);
+    return access(caminho, R_OK) == 0;
+}
+
+// copia a entrada para 'destino' conferindo o resumo no caminho
+// entrada corrompida e apagada; retorna 0 se o destino ficou com o conteudo certo
+int cache_copia(int algoritmo, const uchar *resumo, const char *destino)
+{
+    char caminho[256];
+    caminho_entrada(caminho, sizeof(caminho), algoritmo, resumo);
+    FILE *origem = fopen(caminho, "rb");
+    if (!origem)
+        return -1;
+    FILE *saida = fopen(destino, "wb");
+    if (!saida)
+    {
+        fclose(origem);
+        return -1;
+    }
+
+    Resumo r;
+    resumo_inicia(&r, algoritmo);
+    uchar bloco[65536];
+    size_t n;
+    int erro = 0;
+    while ((n = fread(bloco, 1, sizeof(bloco), origem)) > 0)
+    {
+        resumo_atualiza(&r, bloco, n);
+        if (fwrite(bloco, 1, n, saida) != n)
+            erro = 1;
+    }
+    erro |= ferror(origem);
+    fclose(origem);
+    erro |= fclose(saida) != 0;
+
+    uchar calculado[RESUMO_MAX];
+    int tamanho = resumo_final(&r, calculado);
+    if (!erro && memcmp(calculado, resumo, tamanho) != 0)
+    {
+        fprintf(stderr, "Entrada do cache corrompida, descartada: %s\n", caminho);
+        unlink(caminho);
+        erro = 1;
+    }
+    if (erro)
+    {
+        unlink(destino);
+        return -1;
+    }
+
+    // usado agora: vai para o fim da fila de remocao
+    utimensat(AT_FDCWD, caminho, NULL, 0);
+    return 0;
+}
+
+// guarda um objeto ja conferido; escreve num temporario e renomeia,
+// assim uma entrada nunca aparece pela metade
+void cache_guarda(int algoritmo, const uchar *resumo, const char *origem)
+{
+    struct stat st;
+    if (!limite || algoritmo == RESUMO_NENHUM || stat(origem, &st) != 0 || st.st_size > limite)
+        return;
+
+    char caminho[256], temporario[sizeof(diretorio) + 32];
+    caminho_entrada(caminho, sizeof(caminho), algoritmo, resumo);
+    snprintf(temporario, sizeof(temporario), "%s/.novo-%d", diretorio, (int)getpid());
+
+    FILE *f = fopen(origem, "rb");
+    FILE *t = f ? fopen(temporario, "wb") : NULL;
+    int erro = !t;
+    if (t)
+    {
+        uchar bloco[65536];
+        size_t n;
+        while ((n = fread(bloco, 1, sizeof(bloco), f)) > 0)
+            if (fwrite(bloco, 1, n, t) != n)
+                erro = 1;
+        erro |= ferror(f);
+        erro |= fclose(t) != 0;
+    }
+    if (f)
+        fclose(f);
+    if (erro || rename(temporario, caminho) != 0)
+    {
+        unlink(temporario);
+        return;
+    }
+    cache_limita();
+}
@@ -0,0 +1,14 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "protocolo.h"
+
+// cache de objetos do cliente, enderecado pelo resumo do conteudo
+// cada entrada e um arquivo "<algoritmo>-<resumo em hex>" no diretorio do cache
+// a data de modificacao marca o ultimo uso: passando do limite, saem as mais antigas
+int cache_inicia(const char *diretorio, int limite_mb);
+int cache_tem(int algoritmo, const uchar *resumo);
+int cache_copia(int algoritmo, const uchar *resumo, const char *destino);
+void cache_guarda(int algoritmo, const uchar *resumo, const char *origem);
+
+#endif
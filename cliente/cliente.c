@@ -2,35 +2,77 @@
 #include <stdlib.h>
 #include <string.h>
 #include "protocolo.h"
+#include "recepcao.h"
+#include "fec.h"
+#include "buffer.h"
+#include "uring.h"
+#include "config.h"
+#include "sessao.h"
+#include "congestionamento.h"
+#include "resumo.h"
+#include "cache.h"
+#include "mapa.h"
+#include "tela.h"
+#include "registro.h"
+#include "reprodutor.h"
+#include "gravador.h"
+#include "batimento.h"
+#include "giro.h"
+#include "latencia.h"
+#include "enlaces.h"
 #include <unistd.h>
+#include <errno.h>
+#include <signal.h>
 #include <sys/statvfs.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
 
-#define INTERFACE "enp0s31f6"                             // interface
-#define TIMEOUT_ACK 2000                                  // 2 segundos
-#define MAC_SERVIDOR {0xff, 0xff, 0xff, 0xff, 0xff, 0xff} // broadcast
+#define TIMEOUT_ARQUIVO (config.tentativas * config.timeout_ms) // cobre todas as tentativas do servidor
+#define MAC_SERVIDOR {0xff, 0xff, 0xff, 0xff, 0xff, 0xff} // broadcast ate a primeira resposta
+#define PEDIDOS_RESUMO 3                                  // vezes que um objeto com resumo errado e pedido de novo
+#define LOTE_RECEPCAO 32                                  // frames do objeto tratados antes de voltar ao epoll
 #define VAZIO 0
 #define PERCORRIDO 1
 #define TESOURO 2
 #define JOGADOR 3
 
-// enum para estados da celula do grid
-typedef enum
+// frame enviado e ainda sem ACK, retransmitido pelo timer sem parar o loop de eventos:
+// o movimento digitado ou um erro avisado ao servidor (envia_erro)
+typedef struct
 {
-    CELULA_VAZIA,
-    CELULA_PERCORRIDA,
-    CELULA_TESOURO_COLETADO,
-    CELULA_JOGADOR
-} EstadoCelula;
+    int ativo;
+    BufferFrame *b;
+    int tentativas;       // envios que ainda restam
+    int retransmitido;    // o ACK pode ser de um envio anterior, sem amostra de RTT
+    long long inicio_ns;  // primeiro envio, para a latencia
+    long long enviado_ns; // ultimo envio, para o RTT
+} Movimento;
 
-// struct para cada celula do grid
+// objeto sendo recebido: o loop de eventos entrega os frames conforme chegam
+// e o timer confere o prazo entre eles
 typedef struct
 {
-    EstadoCelula estado;
-    int tem_tesouro;
-} Celula;
+    int ativa;
+    uchar tipo; // do anuncio: 6 texto, 7 imagem, 8 video
+    char nome[128];
+    FILE *f;
+    Resumo resumo;
+    uchar esperado[1 + RESUMO_MAX]; // algoritmo e resumo que vieram no fim
+    int tamanho_esperado;
+    Reprodutor reprodutor;
+    int continua; // o visualizador recebe os dados enquanto o objeto chega
+    Recepcao recepcao;
+    DecodificadorFEC fec;
+    int anel;            // grava pelo io_uring
+    int em_thread;       // grava pela thread de gravacao
+    long long gravados;
+    int erro_gravacao;   // errno da primeira escrita que falhou
+    long long ultimo_ms; // chegada do ultimo frame
+} Transferencia;
 
-// grid
-Celula grid[8][8] = {{0}};
+// grid: um bit por celula, do tamanho do mapa da configuracao
+Celulas percorridas;
+Celulas coletados;
 
 // posicao atual do jogador
 Posicao pos_atual = {0, 0};
@@ -38,68 +80,147 @@ Posicao pos_atual = {0, 0};
 uchar mac_servidor[6] = MAC_SERVIDOR;
 // numero de sequencia para frames
 uchar sequencia = 0;
+// se ainda esperamos a resposta do servidor ao ultimo movimento
+int aguardando_resposta = 0;
+// movimento em voo e objeto em andamento, um de cada vez
+Movimento movimento;
+Transferencia transferencia;
+// pedidos seguidos do mesmo objeto por resumo errado
+int pedidos_resumo = 0;
+// o detector ja avisou que o servidor parou de responder
+int servidor_mudo = 0;
+// do envio de cada movimento ate o ACK, mostradas ao sair
+Latencias latencias;
+// thread de gravacao dos objetos, com o anel reaproveitado entre eles
+Gravador gravador;
+// linha parcial lida da entrada
+char linha[256];
+size_t linha_usada = 0;
+
+// indice da celula (x, y) nos bitsets do grid
+long long celula(int x, int y)
+{
+    return x + (long long)y * config.largura;
+}
 
 // inicializa todas as celulas como vazias
-void inicializa_grid()
+int inicializa_grid()
 {
-    for (int i = 0; i < 8; i++)
-    {
-        for (int j = 0; j < 8; j++)
-        {
-            grid[i][j] = (Celula){CELULA_VAZIA, 0};
-        }
-    }
+    long long n = (long long)config.largura * config.altura;
+    return celulas_inicia(&percorridas, n) == 0 && celulas_inicia(&coletados, n) == 0 ? 0 : -1;
 }
 
-// imprime o grid
+// imprime o grid, so o que mudou desde o ultimo desenho (tela.h)
 void imprime_grid()
 {
-    // limpa a tela
-    printf("\033[H\033[J");
-    printf("Caça ao Tesouro - Posição: (%d, %d)\n", pos_atual.x, pos_atual.y);
+    tela_desenha(&percorridas, &coletados, pos_atual);
+}
+
+// marca a celula como percorrida; no desenho o tesouro coletado tem precedencia
+void marca_percorrido()
+{
+    celulas_liga(&percorridas, celula(pos_atual.x, pos_atual.y));
+}
+
+// le o anuncio: nome, '\0', algoritmo do resumo e resumo do conteudo (os dois ultimos podem faltar)
+// retorna o tamanho do resumo do conteudo, 0 se nao veio
+int le_anuncio(const Frame *anuncio, char *nome, int *algoritmo, uchar *resumo)
+{
+    memcpy(nome, anuncio->dados, anuncio->tamanho);
+    nome[anuncio->tamanho] = '\0';
+    size_t tamanho_nome = strlen(nome);
+    *algoritmo = tamanho_nome + 1 < anuncio->tamanho ? anuncio->dados[tamanho_nome + 1] : RESUMO_NENHUM;
+    int tamanho = resumo_tamanho(*algoritmo);
+    if (!tamanho || tamanho_nome + 2 + tamanho > anuncio->tamanho)
+        return 0;
+    memcpy(resumo, anuncio->dados + tamanho_nome + 2, tamanho);
+    return tamanho;
+}
+
+// marca a celula como tesouro coletado
+void marca_coletado()
+{
+    celulas_liga(&coletados, celula(pos_atual.x, pos_atual.y));
+}
+
+// exibe o objeto recebido com base no tipo: 'cat' para texto, 'feh' para imagem e 'mpv' para video
+void exibe_arquivo(uchar tipo, const char *nome_arquivo)
+{
+    if (tipo == 6)
+        printf("Conteúdo do texto:\n");
+    fflush(stdout);
+    reprodutor_arquivo(tipo, nome_arquivo);
+    marca_coletado();
+}
+
+// arma o timer para daqui a 'ms', so uma vez ou a cada 'ms'; com 0 desarma
+void arma_timer(int timer, int ms, int periodico)
+{
+    struct itimerspec prazo = {0};
+    prazo.it_value.tv_sec = ms / 1000;
+    prazo.it_value.tv_nsec = (ms % 1000) * 1000000L;
+    if (periodico)
+        prazo.it_interval = prazo.it_value;
+    timerfd_settime(timer, 0, &prazo, NULL);
+}
+
+// envia (ou reenvia) o movimento em voo, no ritmo do servidor, e arma a retransmissao
+void movimento_envia(int sock, int timer)
+{
+    Par *par = par_busca(mac_servidor);
+    ritmo_espera(par, buffer_total(movimento.b));
+    movimento.enviado_ns = timestamp_ns();
+    enviar_buffer(sock, movimento.b, mac_servidor);
+    movimento.tentativas--;
+    arma_timer(timer, cc_timeout_ms(par, config.timeout_ms), 0);
+}
+
+// avisa o servidor de um erro sem parar o loop de eventos: o frame fica em voo como um
+// movimento, com as mesmas retransmissoes pelo timer
+void envia_erro(int sock, int timer, uchar seq, uchar codigo)
+{
+    BufferFrame *b = buffer_aloca();
+    if (!b)
+        return;
+    buffer_monta(b, seq, 15, &codigo, 1);
+    movimento = (Movimento){1, b, config.tentativas, 0, timestamp_ns(), 0};
+    movimento_envia(sock, timer);
+}
 
-    for (int j = 7; j >= 0; j--)
+// pede o ultimo objeto de novo ao servidor, ate PEDIDOS_RESUMO vezes seguidas
+// retorna 0 se pediu
+int pede_de_novo(int sock, int timer)
+{
+    if (pedidos_resumo++ >= PEDIDOS_RESUMO)
     {
-        printf(" ");
-        for (int i = 0; i < 8; i++)
-        {
-            if (i == pos_atual.x && j == pos_atual.y)
-            {
-                // jogador na celula atual
-                printf("[@]");
-            }
-            else
-            {
-                switch (grid[i][j].estado)
-                {
-                case CELULA_TESOURO_COLETADO:
-                    printf("[X]"); // tesouro coletado
-                    break;
-                case CELULA_PERCORRIDA:
-                    printf("[.]"); // ja percorrido
-                    break;
-                default:
-                    printf("[ ]"); // ainda nao passou
-                }
-            }
-        }
-        printf("\n");
+        pedidos_resumo = 0;
+        return -1;
     }
-    printf("Legenda: @=Você, X=Tesouro Coletado, .=Percorrido\n");
+    envia_erro(sock, timer, sequencia, ERRO_RESUMO);
+    return 0;
 }
 
-// marca a celula como percorrida, caso nao tenha tesouro
-void marca_percorrido()
+// o anuncio e de um objeto que ja esta no cache: copia de la em vez de baixar
+// o servidor ja recebeu o TIPO_TEM, entao uma entrada estragada faz pedir o objeto de novo
+void arquivo_do_cache(int sock, int timer, const Frame *anuncio, const char *nome_arquivo, int algoritmo,
+                      const uchar *resumo)
 {
-    if (grid[pos_atual.x][pos_atual.y].estado != CELULA_TESOURO_COLETADO)
+    printf("Objeto %s ja esta no cache\n", nome_arquivo);
+    if (cache_copia(algoritmo, resumo, nome_arquivo) != 0)
     {
-        grid[pos_atual.x][pos_atual.y].estado = CELULA_PERCORRIDA;
+        if (pede_de_novo(sock, timer) != 0)
+            printf("Objeto %s nao recuperado do cache\n", nome_arquivo);
+        return;
     }
+    pedidos_resumo = 0;
+    exibe_arquivo(anuncio->tipo, nome_arquivo);
 }
 
-// recebe um arquivo do servidor
-void receber_arquivo(int sock, Frame *resposta)
+// comeca a receber o objeto anunciado; os frames chegam pelo loop de eventos (transferencia_recebe)
+void receber_arquivo(int sock, int timer, Frame *resposta)
 {
+    Transferencia *t = &transferencia;
+
     // verifica se tem espaco livre
     struct statvfs st;
     if (statvfs(".", &st) == 0)
@@ -109,9 +230,7 @@ void receber_arquivo(int sock, Frame *resposta)
         if (espaco_livre < 1048576)
         {
             // se nao tem, envia erro
-            uchar codigo_erro = ERRO_ESPACO_INSUFICIENTE;
-            Frame erro = criar_frame(resposta->sequencia, 15, &codigo_erro, 1);
-            enviar_com_ack(sock, &erro, mac_servidor, TIMEOUT_ACK);
+            envia_erro(sock, timer, resposta->sequencia, ERRO_ESPACO_INSUFICIENTE);
             return;
         }
     }
@@ -120,64 +239,212 @@ void receber_arquivo(int sock, Frame *resposta)
         perror("Erro ao verificar espaço livre");
     }
 
-    // extrai o nome do arquivo dos dados do frame
-    char nome_arquivo[128];
-    strncpy(nome_arquivo, (char *)resposta->dados, resposta->tamanho);
-    nome_arquivo[resposta->tamanho] = '\0';
+    // extrai o nome do arquivo dos dados do frame; depois do '\0' vem o algoritmo do resumo
+    int algoritmo;
+    uchar anunciado[RESUMO_MAX];
+    le_anuncio(resposta, t->nome, &algoritmo, anunciado);
+    resumo_inicia(&t->resumo, algoritmo);
+    t->tamanho_esperado = 0;
 
-    printf("Recebendo arquivo: %s\n", nome_arquivo);
-    FILE *f = fopen(nome_arquivo, "wb");
-    if (!f)
+    printf("Recebendo arquivo: %s\n", t->nome);
+    t->f = fopen(t->nome, "wb");
+    if (!t->f)
     {
         perror("Erro ao criar arquivo");
         return;
     }
 
-    // recebe frames ate sinal de fim (tipo = 9)
-    Frame dado;
-    while (1)
+    // no modo continuo o visualizador ja comeca a mostrar o objeto enquanto ele chega
+    t->tipo = resposta->tipo;
+    t->continua = config.continua && reprodutor_inicia(&t->reprodutor, t->tipo) == 0;
+    if (t->continua && t->tipo == 6)
+        printf("Conteúdo do texto:\n");
+    fflush(stdout);
+
+    // os frames do arquivo vem numerados a partir do anuncio
+    recepcao_inicia(&t->recepcao, resposta->sequencia + 1);
+
+    // com io_uring os dados vao para o arquivo direto dos buffers recebidos;
+    // na thread a espera do disco nao atrasa os ACKs (config.gravacao)
+    t->anel = config.gravacao == GRAVACAO_URING && uring_ativo(sock);
+    t->em_thread = !t->anel && config.gravacao != GRAVACAO_DIRETA && gravador_inicia(&gravador, fileno(t->f)) == 0;
+    t->gravados = 0;
+    t->erro_gravacao = 0;
+
+    // guarda os frames recentes para reconstruir perdas pela paridade
+    fec_inicia(&t->fec);
+
+    // o timer confere o prazo entre os frames, a cada batimento ou timeout
+    t->ultimo_ms = timestamp_ms();
+    t->ativa = 1;
+    int fatia = config.batimento_ms > 0 && config.batimento_ms < config.timeout_ms ? config.batimento_ms
+                                                                                   : config.timeout_ms;
+    arma_timer(timer, fatia, 1);
+}
+
+// um frame do objeto: as paridades reconstroem as perdas, e o que estiver em ordem e gravado
+// os frames ficam nos buffers em que chegaram, ate serem gravados
+// retorna 1 quando o fim do arquivo (tipo 9) foi entregue
+int transferencia_frame(int sock, BufferFrame *dado)
+{
+    Transferencia *t = &transferencia;
+    if (buffer_tipo(dado) == TIPO_PARIDADE)
     {
-        if (receber_com_ack(sock, &dado, NULL, TIMEOUT_ACK) != 0)
-            break;
+        // reconstroi os frames perdidos do grupo e confirma cada um,
+        // marcando no ACK que veio da paridade
+        BufferFrame *recuperados[FEC_MAX_PARIDADE];
+        int n = fec_recupera(&t->fec, dado, recuperados);
+        for (int i = 0; i < n; i++)
+        {
+            uchar recuperado = 1;
+            Frame ack = criar_frame(buffer_sequencia(recuperados[i]), 0, &recuperado, 1);
+            enviar_frame(sock, &ack, mac_servidor);
+            recepcao_aceita(&t->recepcao, recuperados[i]);
+            buffer_solta(recuperados[i]);
+        }
+    }
+    // repetidos ja foram confirmados de novo, mas nao sao gravados,
+    // e um batimento atrasado de antes do anuncio nao faz parte do objeto
+    else if (buffer_tipo(dado) != TIPO_BATIMENTO && recepcao_aceita(&t->recepcao, dado))
+    {
+        fec_guarda_dados(&t->fec, dado);
+    }
+    buffer_solta(dado);
 
-        if (dado.tipo == 9) // fim do arquivo
+    // grava tudo o que ja esta em ordem
+    int fim = 0;
+    while (!fim && (dado = recepcao_entrega(&t->recepcao)) != NULL)
+    {
+        if (buffer_tipo(dado) == 9) // fim do arquivo, com o resumo do servidor
         {
-            break;
+            fim = 1;
+            t->tamanho_esperado = buffer_tamanho(dado) < sizeof(t->esperado) ? buffer_tamanho(dado) : sizeof(t->esperado);
+            memcpy(t->esperado, buffer_dados(dado), t->tamanho_esperado);
         }
-        else if (dado.tipo == 5) // dados
+        else if (buffer_tipo(dado) == 5) // dados
         {
-            fwrite(dado.dados, 1, dado.tamanho, f);
+            resumo_atualiza(&t->resumo, buffer_dados(dado), buffer_tamanho(dado));
+            if (t->continua)
+                reprodutor_envia(&t->reprodutor, buffer_dados(dado), buffer_tamanho(dado));
+            // com a fila de submissao cheia mesmo depois de esvaziada, grava direto
+            if (t->anel)
+            {
+                if (uring_escreve(fileno(t->f), dado, t->gravados) != 0 &&
+                    pwrite(fileno(t->f), buffer_dados(dado), buffer_tamanho(dado), t->gravados) != buffer_tamanho(dado) &&
+                    !t->erro_gravacao)
+                    t->erro_gravacao = errno;
+            }
+            else if (t->em_thread)
+                gravador_escreve(&gravador, buffer_dados(dado), buffer_tamanho(dado), t->gravados);
+            else if (fwrite(buffer_dados(dado), 1, buffer_tamanho(dado), t->f) != buffer_tamanho(dado) &&
+                     !t->erro_gravacao)
+                t->erro_gravacao = errno;
+            t->gravados += buffer_tamanho(dado);
         }
+        buffer_solta(dado);
     }
-    fclose(f);
-    printf("Arquivo recebido com sucesso!\n");
+    return fim;
+}
 
-    // exibo o conteudo com base no tipo
-    if (resposta->tipo == 6)
+// encerra o objeto: espera o disco, confere o resumo e mostra
+// sem o fim (transferencia abortada) o arquivo incompleto e apagado
+void transferencia_termina(int sock, int timer, int fim)
+{
+    Transferencia *t = &transferencia;
+    t->ativa = 0;
+    arma_timer(timer, 0, 0);
+    recepcao_termina(&t->recepcao);
+    fec_termina(&t->fec);
+    if (t->anel && uring_espera_escritas() != 0 && !t->erro_gravacao)
+        t->erro_gravacao = errno;
+    if (t->em_thread)
     {
-        // se for texto, usa 'cat'
-        printf("Conteúdo do texto:\n");
-        char cmd[256];
-        snprintf(cmd, sizeof(cmd), "cat %s", nome_arquivo);
-        system(cmd);
+        if (gravador_termina(&gravador) != 0 && !t->erro_gravacao)
+            t->erro_gravacao = errno;
+        if (gravador.cheio)
+            registra(REG_INFO, "Disco atrasou a recepcao %d vezes", gravador.cheio);
     }
-    else if (resposta->tipo == 8)
+    if (fclose(t->f) != 0 && !t->erro_gravacao)
+        t->erro_gravacao = errno;
+
+    if (!fim)
     {
-        // se for imagem usa 'feh'
-        char cmd[256];
-        snprintf(cmd, sizeof(cmd), "feh %s &", nome_arquivo);
-        system(cmd);
+        if (t->continua)
+            reprodutor_cancela(&t->reprodutor);
+        unlink(t->nome);
+        imprime_grid();
+        return;
     }
-    else if (resposta->tipo == 7)
+
+    // arquivo incompleto no disco: como um resumo errado, nao vai para o cache e e pedido de novo
+    if (t->erro_gravacao)
     {
-        // se for video usa 'mpv'
-        char cmd[256];
-        snprintf(cmd, sizeof(cmd), "mpv %s &", nome_arquivo);
-        system(cmd);
+        printf("Erro ao gravar arquivo: %s\n", strerror(t->erro_gravacao));
+        if (t->continua)
+            reprodutor_cancela(&t->reprodutor);
+        unlink(t->nome);
+        if (pede_de_novo(sock, timer) != 0)
+            printf("Arquivo descartado depois de %d pedidos\n", PEDIDOS_RESUMO);
+        return;
     }
-    // marca a celula como tesouro coletado
-    grid[pos_atual.x][pos_atual.y].estado = CELULA_TESOURO_COLETADO;
-    grid[pos_atual.x][pos_atual.y].tem_tesouro = 1;
+
+    // confere o resumo calculado enquanto os dados chegavam; se nao bate, pede o objeto de novo
+    if (t->resumo.algoritmo != RESUMO_NENHUM)
+    {
+        uchar calculado[1 + RESUMO_MAX] = {t->resumo.algoritmo};
+        int tamanho = 1 + resumo_final(&t->resumo, calculado + 1);
+        if (tamanho != t->tamanho_esperado || memcmp(calculado, t->esperado, tamanho) != 0)
+        {
+            printf("Resumo %s do arquivo nao confere!\n", resumo_nome(t->resumo.algoritmo));
+            if (t->continua)
+                reprodutor_cancela(&t->reprodutor);
+            if (pede_de_novo(sock, timer) != 0)
+            {
+                printf("Arquivo descartado depois de %d pedidos\n", PEDIDOS_RESUMO);
+                unlink(t->nome);
+            }
+            return;
+        }
+        // conferido, vai para o cache com o resumo que o servidor mandou
+        cache_guarda(t->resumo.algoritmo, calculado + 1, t->nome);
+    }
+    pedidos_resumo = 0;
+    if (t->continua)
+    {
+        // o visualizador ja tem tudo, so falta fechar a entrada dele
+        reprodutor_fecha(&t->reprodutor);
+        marca_coletado();
+    }
+    printf("Arquivo recebido com sucesso!\n");
+    if (!t->continua)
+        exibe_arquivo(t->tipo, t->nome);
+    imprime_grid();
+}
+
+// trata os frames do objeto que ja chegaram, por qualquer enlace, sem esperar
+// no maximo um lote por vez, e o loop de eventos volta a atender os timers entre eles
+void transferencia_recebe(int sock, int timer)
+{
+    BufferFrame *dado;
+    for (int i = 0; i < LOTE_RECEPCAO && transferencia.ativa && enlaces_recebe(&dado, mac_servidor, 0) >= 0; i++)
+    {
+        transferencia.ultimo_ms = timestamp_ms();
+        if (transferencia_frame(sock, dado))
+            transferencia_termina(sock, timer, 1);
+    }
+}
+
+// timer durante o objeto: desiste se o servidor se calou por TIMEOUT_ARQUIVO, ou assim que
+// o detector o da por morto, em vez de esperar todas as tentativas dele
+void transferencia_prazo(int sock, int timer)
+{
+    if (batimento_falhou(par_busca(mac_servidor)))
+        printf("Servidor parou de responder, transferencia abortada\n");
+    else if (timestamp_ms() - transferencia.ultimo_ms >= TIMEOUT_ARQUIVO)
+        printf("Servidor nao mandou o resto do objeto, transferencia abortada\n");
+    else
+        return;
+    transferencia_termina(sock, timer, 0);
 }
 
 // imprimir erro enviado pelo servidor
@@ -196,113 +463,436 @@ void tratar_erro(uchar codigo)
     }
 }
 
-int main()
+// o servidor nao confirmou o movimento em nenhuma tentativa
+// a sequencia avanca assim mesmo, o proximo nao pode parecer uma retransmissao deste
+void movimento_desiste(int timer)
+{
+    if (buffer_tipo(movimento.b) != 15)
+        sequencia = (sequencia + 1) % 32;
+    buffer_solta(movimento.b);
+    movimento.ativo = 0;
+    arma_timer(timer, 0, 0);
+    printf("Falha na comunicação com o servidor!\n");
+}
+
+// sem ACK no prazo: reenvia, a nao ser que as tentativas acabaram ou o servidor ja foi dado como morto
+void movimento_expira(int sock, int timer)
+{
+    Par *par = par_busca(mac_servidor);
+    if (movimento.tentativas == 0 || batimento_falhou(par))
+    {
+        movimento_desiste(timer);
+        return;
+    }
+    registra(REG_AVISO, "Timeout. Reenviando frame...");
+    cc_perda(par);
+    movimento.retransmitido = 1;
+    movimento_envia(sock, timer);
+}
+
+// o servidor recebeu o movimento: anda no grid e espera a resposta dele
+// 'ack' e o ACK do movimento, uma amostra de RTT se nao houve retransmissao
+void movimento_confirmado(int sock, int timer, BufferFrame *ack)
+{
+    if (ack && !movimento.retransmitido)
+    {
+        long long rtt = mede_rtt(sock, buffer_sequencia(ack), ack, movimento.enviado_ns);
+        if (rtt >= 0)
+            cc_ack(par_busca(mac_servidor), rtt);
+    }
+    uchar tipo_mov = buffer_tipo(movimento.b);
+    // um erro avisado so precisava chegar, mas o objeto pedido de novo e esperado como a
+    // resposta de um movimento: o proximo comando nao sai enquanto ele vem
+    int pede_objeto = tipo_mov == 15 && buffer_dados(movimento.b)[0] == ERRO_RESUMO;
+    buffer_solta(movimento.b);
+    movimento.ativo = 0;
+    if (tipo_mov == 15)
+    {
+        arma_timer(timer, pede_objeto ? config.timeout_ms : 0, 0);
+        aguardando_resposta = pede_objeto;
+        return;
+    }
+    latencia_anota(&latencias, timestamp_ns() - movimento.inicio_ns);
+
+    // incrementa a sequencia
+    sequencia = (sequencia + 1) % 32; // Atualiza sequência
+    // marca a celula
+    marca_percorrido();
+    // atualiza a posicao (dentro dos limites)
+    switch (tipo_mov)
+    {
+    case 10:
+        if (pos_atual.x < config.largura - 1)
+            pos_atual.x++;
+        break;
+    case 11:
+        if (pos_atual.y < config.altura - 1)
+            pos_atual.y++;
+        break;
+    case 12:
+        if (pos_atual.y > 0)
+            pos_atual.y--;
+        break;
+    case 13:
+        if (pos_atual.x > 0)
+            pos_atual.x--;
+        break;
+    }
+    // atualiza o grid sem esperar a resposta do servidor
+    imprime_grid();
+
+    // arma o timer que avisa caso a resposta nao chegue
+    arma_timer(timer, config.timeout_ms, 0);
+    aguardando_resposta = 1;
+}
+
+// processa um comando digitado, retorna 0 se o jogador pediu para sair
+// o movimento fica em voo ate o ACK, e o loop de eventos segue enquanto isso
+int processa_comando(int sock, int timer, char comando)
+{
+    // sair ao digitar 'q' ou 'Q'
+    if (comando == 'q' || comando == 'Q')
+        return 0;
+
+    // cria frame de movimento
+    uchar tipo_mov;
+    switch (comando)
+    {
+    case 'w':
+    case 'W':
+        tipo_mov = 11; // cima
+        break;
+    case 's':
+    case 'S':
+        tipo_mov = 12; // baixo
+        break;
+    case 'a':
+    case 'A':
+        tipo_mov = 13; // esquerda
+        break;
+    case 'd':
+    case 'D':
+        tipo_mov = 10; // direita
+        break;
+    default:
+        printf("Comando inválido!\n");
+        return 1;
+    }
+
+    BufferFrame *b = buffer_aloca();
+    if (!b)
+    {
+        printf("Falha na comunicação com o servidor!\n");
+        return 1;
+    }
+    buffer_monta(b, sequencia, tipo_mov, NULL, 0);
+
+    // envia o frame para o servidor
+    movimento = (Movimento){1, b, config.tentativas, 0, timestamp_ns(), 0};
+    movimento_envia(sock, timer);
+    return 1;
+}
+
+// trata um frame que chegou do servidor fora de um objeto
+void processa_socket(int sock, int timer)
+{
+    // aprende o MAC real do servidor, assim os proximos frames vao em unicast
+    // a resposta fica para depois de ver se e o anuncio de um objeto que ja temos
+    BufferFrame *b;
+    if (tentar_receber_sem_ack(sock, &b, mac_servidor) != 0)
+        return;
+
+    // o movimento em voo: o ACK dele nao e respondido, o NACK pede outro envio, e qualquer
+    // outra resposta com a mesma sequencia mostra que o servidor ja o recebeu
+    if (movimento.ativo && buffer_tipo(b) != TIPO_BATIMENTO && buffer_sequencia(b) == buffer_sequencia(movimento.b))
+    {
+        if (buffer_tipo(b) == 1)
+        {
+            buffer_solta(b);
+            movimento.retransmitido = 1;
+            if (movimento.tentativas == 0)
+                movimento_desiste(timer);
+            else
+                movimento_envia(sock, timer);
+            return;
+        }
+        movimento_confirmado(sock, timer, buffer_tipo(b) == 0 ? b : NULL);
+        if (buffer_tipo(b) == 0)
+        {
+            buffer_solta(b);
+            return;
+        }
+    }
+
+    Frame resposta;
+    buffer_para_frame(b, &resposta);
+    buffer_solta(b);
+
+    char nome_arquivo[128];
+    int algoritmo = RESUMO_NENHUM;
+    uchar resumo[RESUMO_MAX];
+    int anuncio = resposta.tipo >= 6 && resposta.tipo <= 8;
+    int no_cache = anuncio && le_anuncio(&resposta, nome_arquivo, &algoritmo, resumo) &&
+                   cache_tem(algoritmo, resumo);
+    if (no_cache)
+        responder(sock, resposta.sequencia, TIPO_TEM, mac_servidor);
+    else if (confirmado(resposta.tipo))
+        responder(sock, resposta.sequencia, 0, mac_servidor);
+
+    // batimento do servidor: so o sinal de vida, que o detector ja contou
+    if (resposta.tipo == TIPO_BATIMENTO)
+        return;
+
+    // qualquer frame valido do servidor responde o ultimo movimento
+    if (aguardando_resposta)
+    {
+        arma_timer(timer, 0, 0);
+        aguardando_resposta = 0;
+    }
+
+    if (resposta.tipo == 15) // caso for erro
+    {
+        tratar_erro(resposta.dados[0]);
+    }
+    else if (no_cache) // ou arquivo que ja temos
+    {
+        arquivo_do_cache(sock, timer, &resposta, nome_arquivo, algoritmo, resumo);
+        imprime_grid();
+    }
+    else if (anuncio) // ou arquivo, recebido pelo loop de eventos daqui em diante
+    {
+        receber_arquivo(sock, timer, &resposta);
+    }
+}
+
+// o timer: retransmissao do movimento em voo, prazo do objeto ou da resposta ao movimento
+void processa_timer(int sock, int timer)
 {
+    uint64_t expiracoes;
+    if (read(timer, &expiracoes, sizeof(expiracoes)) <= 0)
+        return;
+    if (transferencia.ativa)
+    {
+        transferencia_prazo(sock, timer);
+    }
+    else if (movimento.ativo)
+    {
+        movimento_expira(sock, timer);
+    }
+    else if (aguardando_resposta)
+    {
+        aguardando_resposta = 0;
+        printf("Servidor não respondeu ao último movimento.\n");
+    }
+}
+
+// batimento periodico: sinal de vida para o servidor e, se ele se calou, um aviso
+void processa_pulso(int sock, int pulso)
+{
+    uint64_t expiracoes;
+    if (read(pulso, &expiracoes, sizeof(expiracoes)) <= 0)
+        return;
+    batimento_pulsa(sock, mac_servidor);
+    enlaces_apresenta();
+    int mudo = batimento_falhou(par_busca(mac_servidor));
+    if (mudo && !servidor_mudo)
+        printf("Servidor parou de responder (phi %.1f)\n", batimento_phi(par_busca(mac_servidor), timestamp_ns()));
+    else if (!mudo && servidor_mudo)
+        printf("Servidor voltou a responder\n");
+    servidor_mudo = mudo;
+}
+
+// le o que estiver disponivel na entrada; as linhas esperam em 'linha' o cliente ficar livre
+// retorna 0 quando a entrada termina
+int processa_entrada(void)
+{
+    if (linha_usada == sizeof(linha))
+        return 1;
+    ssize_t n = read(STDIN_FILENO, linha + linha_usada, sizeof(linha) - linha_usada);
+    if (n <= 0)
+        return 0;
+    linha_usada += n;
+
+    // linha maior que o buffer, descarta
+    if (linha_usada == sizeof(linha) && !memchr(linha, '\n', linha_usada))
+        linha_usada = 0;
+    return 1;
+}
+
+// processa a primeira linha completa; so o primeiro caractere importa
+// retorna 0 se o jogador pediu para sair
+int proximo_comando(int sock, int timer)
+{
+    char *fim = memchr(linha, '\n', linha_usada);
+    size_t tamanho = fim - linha + 1;
+    int continua = processa_comando(sock, timer, linha[0]);
+    memmove(linha, linha + tamanho, linha_usada - tamanho);
+    linha_usada -= tamanho;
+    return continua;
+}
+
+int main(int argc, char **argv)
+{
+    // parametros da sessao: arquivo e linha de comando
+    if (config_le(&config, argc, argv) != 0)
+        return 1;
+
+    // mensagens do protocolo saem por uma thread de fundo
+    registro_inicia(config.registro);
+    // visualizador fechado no meio do objeto vira EPIPE no pipe, nao derruba o cliente
+    signal(SIGPIPE, SIG_IGN);
+
     // cria o raw socket
-    int sock = cria_raw_socket(INTERFACE);
+    int sock = cria_raw_socket(config.interface);
     if (sock < 0)
     {
         fprintf(stderr, "Erro ao criar socket raw\n");
         return 1;
     }
 
-    printf("Cliente iniciado. Conectado à interface %s\n", INTERFACE);
+    if (config.uring && uring_inicia(sock) == 0)
+        printf("Usando io_uring\n");
+    // um socket por interface a mais, so para os dados dos objetos
+    if (enlaces_abre(sock) > 1)
+        printf("Objetos recebidos por %d enlaces\n", n_enlaces);
+
+    // sonda o enlace e combina com o servidor o que o usuario nao fixou
+    if (config.sondar && sessao_negocia(sock, mac_servidor, &config) != 0)
+        printf("Servidor nao respondeu a sondagem, usando os parametros configurados\n");
+    config_mostra(&config);
+    enlaces_apresenta();
+    if (cache_inicia(config.cache, config.cache_mb) == 0)
+        printf("Cache de objetos em %s, ate %d MB\n", config.cache, config.cache_mb);
+
+    printf("Cliente iniciado. Conectado à interface %s\n", config.interface);
     // configura o grid
-    inicializa_grid();
+    if (inicializa_grid() != 0 || tela_inicia(config.largura, config.altura) != 0)
+    {
+        fprintf(stderr, "Erro ao criar o grid %dx%d\n", config.largura, config.altura);
+        return 1;
+    }
     // exibe o grid
-    imprime_grid(pos_atual.x, pos_atual.y);
+    imprime_grid();
 
-    // var para leitura da entrada
-    char comando;
-    // loop principal
-    while (1)
+    // timer para o prazo de resposta do servidor
+    int timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    // timer periodico dos batimentos, desarmado com batimento_ms = 0
+    int pulso = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    // epoll sobre a entrada, o socket, os timers e os enlaces a mais
+    int ep = epoll_create1(0);
+    if (ep < 0 || timer < 0 || pulso < 0)
     {
-        comando = getchar();
-        while (getchar() != '\n')
-            ;
-
-        // sair ao digitar 'q' ou 'Q'
-        if (comando == 'q' || comando == 'Q')
-            break;
+        perror("Erro ao criar o loop de eventos");
+        return 1;
+    }
+    if (config.batimento_ms > 0)
+    {
+        struct itimerspec periodo = {0};
+        periodo.it_interval.tv_sec = config.batimento_ms / 1000;
+        periodo.it_interval.tv_nsec = (config.batimento_ms % 1000) * 1000000L;
+        periodo.it_value = periodo.it_interval;
+        timerfd_settime(pulso, 0, &periodo, NULL);
+    }
+    // com io_uring os frames chegam pelo anel, nao mais pelo socket
+    int rede = uring_ativo(sock) ? uring_fd() : sock;
+    int fds[] = {STDIN_FILENO, rede, timer, pulso};
+    for (int i = 0; i < 4 + n_enlaces - 1; i++)
+    {
+        struct epoll_event ev = {0};
+        ev.events = EPOLLIN;
+        ev.data.fd = i < 4 ? fds[i] : enlaces[i - 3].sock;
+        epoll_ctl(ep, EPOLL_CTL_ADD, ev.data.fd, &ev);
+    }
 
-        // cria frame de movimento
-        uchar tipo_mov;
-        switch (comando)
+    // loop principal, reage ao que ficar pronto primeiro
+    // um comando por vez: o proximo espera o ACK e a resposta do anterior, e o objeto que ela trouxer
+    int rodando = 1, lendo = 1, fim_entrada = 0;
+    while (rodando)
+    {
+        int livre = !movimento.ativo && !aguardando_resposta && !transferencia.ativa;
+        if (livre && memchr(linha, '\n', linha_usada))
         {
-        case 'w':
-        case 'W':
-            tipo_mov = 11; // cima
-            break;
-        case 's':
-        case 'S':
-            tipo_mov = 12; // baixo
-            break;
-        case 'a':
-        case 'A':
-            tipo_mov = 13; // esquerda
-            break;
-        case 'd':
-        case 'D':
-            tipo_mov = 10; // direita
-            break;
-        default:
-            printf("Comando inválido!\n");
+            rodando = proximo_comando(sock, timer);
             continue;
         }
+        // com a entrada no fim, sai quando nao houver mais nada em andamento
+        if (livre && fim_entrada)
+            break;
+        // a entrada so e lida com o cliente livre, o resto espera no terminal ou no pipe
+        if (lendo != (livre && !fim_entrada))
+        {
+            lendo = !lendo;
+            struct epoll_event ev = {0};
+            ev.events = EPOLLIN;
+            ev.data.fd = STDIN_FILENO;
+            epoll_ctl(ep, lendo ? EPOLL_CTL_ADD : EPOLL_CTL_DEL, STDIN_FILENO, &ev);
+        }
 
-        Frame movimento = criar_frame(sequencia, tipo_mov, NULL, 0);
-
-        // envia o frame para o servidor
-        if (enviar_com_ack(sock, &movimento, mac_servidor, TIMEOUT_ACK) == 0)
+        // frames que o anel ja colheu nao deixam o fd pronto, trata antes de dormir
+        if (uring_pendentes(sock))
         {
-            // se teve sucesso, entao incrementa a sequencia
-            sequencia = (sequencia + 1) % 32; // Atualiza sequência
-            // marca a celula
-            marca_percorrido();
-            // atualiza a posicao (dentro dos limites)
-            switch (tipo_mov)
-            {
-            case 10:
-                if (pos_atual.x < 7)
-                    pos_atual.x++;
-                break;
-            case 11:
-                if (pos_atual.y < 7)
-                    pos_atual.y++;
-                break;
-            case 12:
-                if (pos_atual.y > 0)
-                    pos_atual.y--;
-                break;
-            case 13:
-                if (pos_atual.x > 0)
-                    pos_atual.x--;
-                break;
-            }
+            if (transferencia.ativa)
+                transferencia_recebe(sock, timer);
+            else
+                processa_socket(sock, timer);
+            continue;
         }
-        else
+
+        struct epoll_event eventos[4 + ENLACES_MAX];
+        int n = epoll_wait(ep, eventos, 4 + ENLACES_MAX, -1);
+        if (n < 0)
         {
-            printf("Falha na comunicação com o servidor!\n");
+            if (errno == EINTR)
+                continue;
+            perror("Erro no epoll_wait");
+            break;
         }
 
-        // verifica resposta do servidor
-        Frame resposta;
-        if (receber_com_ack(sock, &resposta, NULL, 2000) == 0)
+        for (int i = 0; i < n; i++)
         {
-            if (resposta.tipo == 15) // caso for erro
+            int fd = eventos[i].data.fd;
+            if (fd == STDIN_FILENO)
+            {
+                fim_entrada = !processa_entrada();
+            }
+            else if (fd == timer)
+            {
+                processa_timer(sock, timer);
+            }
+            else if (fd == pulso)
             {
-                tratar_erro(resposta.dados[0]);
+                processa_pulso(sock, pulso);
             }
-            else if (resposta.tipo >= 6 && resposta.tipo <= 8) // ou arquivo
+            else if (transferencia.ativa)
             {
-                receber_arquivo(sock, &resposta);
+                // durante o objeto os frames de todos os enlaces sao dele
+                transferencia_recebe(sock, timer);
+            }
+            else if (fd == rede)
+            {
+                processa_socket(sock, timer);
+            }
+            else
+            {
+                enlaces_colhe();
             }
         }
-        // atualiza o grid
-        imprime_grid();
     }
 
     // ao final, fecha o socket e encerra
+    close(ep);
+    close(timer);
+    close(pulso);
+    cc_mostra(par_busca(mac_servidor));
+    double mediana, p99, maximo;
+    int amostras = latencia_percentis(&latencias, &mediana, &p99, &maximo);
+    if (amostras)
+        registra(REG_INFO, "Movimento ate o ACK, %s: %d amostras, mediana %.1f us, p99 %.1f us, max %.1f us",
+                 giro_ativo() ? "modo de giro" : "modo padrao", amostras, mediana, p99, maximo);
+    registro_termina();
+    tela_termina();
+    gravador_libera(&gravador);
+    uring_termina();
     close(sock);
     return 0;
-}
\ No newline at end of file
+}
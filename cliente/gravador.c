@@ -0,0 +1,139 @@
+#include "gravador.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include "giro.h"
+
+#define VETOR_MAX 64 // pedacos contiguos por pwritev
+
+// grava 'n' pedacos a partir de 'leitura', juntando os contiguos no arquivo num so pwritev
+static void grava(Gravador *g, unsigned leitura, unsigned n)
+{
+    while (n > 0 && !g->erro)
+    {
+        struct iovec vetor[VETOR_MAX];
+        Pedaco *primeiro = &g->posicoes[leitura % GRAVADOR_POSICOES];
+        long long fim = primeiro->posicao;
+        int k = 0;
+        size_t total = 0;
+        while (k < VETOR_MAX && (unsigned)k < n)
+        {
+            Pedaco *p = &g->posicoes[(leitura + k) % GRAVADOR_POSICOES];
+            if (p->posicao != fim)
+                break;
+            vetor[k].iov_base = p->dados;
+            vetor[k].iov_len = p->tamanho;
+            fim += p->tamanho;
+            total += p->tamanho;
+            k++;
+        }
+
+        // escrita curta continua de onde parou
+        long long posicao = primeiro->posicao;
+        struct iovec *v = vetor;
+        int restantes = k;
+        while (total > 0)
+        {
+            ssize_t w = pwritev(g->fd, v, restantes, posicao);
+            if (w < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                g->erro = errno;
+                break;
+            }
+            posicao += w;
+            total -= w;
+            while (restantes > 0 && (size_t)w >= v->iov_len)
+            {
+                w -= v->iov_len;
+                v++;
+                restantes--;
+            }
+            if (restantes > 0)
+            {
+                v->iov_base = (char *)v->iov_base + w;
+                v->iov_len -= w;
+            }
+        }
+        leitura += k;
+        n -= k;
+    }
+}
+
+static void *thread_gravacao(void *arg)
+{
+    Gravador *g = arg;
+    giro_livre(1); // fora da CPU do protocolo, se o modo de giro a prendeu
+    for (;;)
+    {
+        unsigned leitura = atomic_load_explicit(&g->leitura, memory_order_relaxed);
+        unsigned escrita = atomic_load_explicit(&g->escrita, memory_order_acquire);
+        if (leitura == escrita)
+        {
+            // so termina com o anel vazio: 'fim' vem depois do ultimo pedaco
+            if (atomic_load_explicit(&g->fim, memory_order_acquire) &&
+                atomic_load_explicit(&g->escrita, memory_order_acquire) == leitura)
+                break;
+            usleep(GRAVADOR_ESPERA_US);
+            continue;
+        }
+        grava(g, leitura, escrita - leitura);
+        atomic_store_explicit(&g->leitura, escrita, memory_order_release);
+    }
+    return NULL;
+}
+
+// sobe a thread de gravacao de um objeto; retorna -1 se nao deu, e a recepcao grava direto
+// 'g' comeca zerado; o anel do objeto anterior e reaproveitado
+int gravador_inicia(Gravador *g, int fd)
+{
+    atomic_init(&g->escrita, 0);
+    atomic_init(&g->leitura, 0);
+    atomic_init(&g->fim, 0);
+    g->erro = 0;
+    g->fd = fd;
+    g->cheio = 0;
+    if (!g->posicoes && !(g->posicoes = malloc(GRAVADOR_POSICOES * sizeof(Pedaco))))
+        return -1;
+    return pthread_create(&g->thread, NULL, thread_gravacao, g) == 0 ? 0 : -1;
+}
+
+// copia o payload para o anel; com o anel cheio espera a thread gravar
+void gravador_escreve(Gravador *g, const uchar *dados, int tamanho, long long posicao)
+{
+    unsigned escrita = atomic_load_explicit(&g->escrita, memory_order_relaxed);
+    if (escrita - atomic_load_explicit(&g->leitura, memory_order_acquire) == GRAVADOR_POSICOES)
+    {
+        g->cheio++;
+        while (escrita - atomic_load_explicit(&g->leitura, memory_order_acquire) == GRAVADOR_POSICOES)
+            usleep(GRAVADOR_ESPERA_US);
+    }
+    Pedaco *p = &g->posicoes[escrita % GRAVADOR_POSICOES];
+    p->posicao = posicao;
+    p->tamanho = tamanho;
+    memcpy(p->dados, dados, tamanho);
+    atomic_store_explicit(&g->escrita, escrita + 1, memory_order_release);
+}
+
+// espera gravar tudo e para a thread; retorna 0, ou -1 com errno da primeira falha
+int gravador_termina(Gravador *g)
+{
+    atomic_store_explicit(&g->fim, 1, memory_order_release);
+    pthread_join(g->thread, NULL);
+    if (g->erro)
+    {
+        errno = g->erro;
+        return -1;
+    }
+    return 0;
+}
+
+// devolve o anel, depois do ultimo objeto
+void gravador_libera(Gravador *g)
+{
+    free(g->posicoes);
+    g->posicoes = NULL;
+}
@@ -0,0 +1,39 @@
+#ifndef GRAVADOR_H
+#define GRAVADOR_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include "protocolo.h"
+
+// gravacao do objeto numa thread propria: quem recebe e confirma os frames so copia o
+// payload num anel (um produtor, um consumidor, sem trava) e segue; a thread grava no disco
+// anel cheio e a contrapressao: a recepcao espera o disco em vez de perder dados
+// o anel e alocado no primeiro objeto e reaproveitado nos seguintes, ate gravador_libera
+#define GRAVADOR_POSICOES 8192 // payloads em voo para o disco (potencia de 2), ~1 MB
+#define GRAVADOR_ESPERA_US 200 // cochilo de quem espera, com o anel vazio ou cheio
+
+typedef struct
+{
+    long long posicao;
+    int tamanho;
+    uchar dados[MAX_DADOS];
+} Pedaco;
+
+typedef struct
+{
+    _Alignas(64) atomic_uint escrita; // avancado pela recepcao
+    _Alignas(64) atomic_uint leitura; // avancado pela thread de gravacao
+    _Alignas(64) atomic_int fim;
+    int erro;    // errno da primeira falha, lido depois do join
+    int fd;
+    int cheio;   // vezes que a recepcao esperou o disco
+    Pedaco *posicoes;
+    pthread_t thread;
+} Gravador;
+
+int gravador_inicia(Gravador *g, int fd);
+void gravador_escreve(Gravador *g, const uchar *dados, int tamanho, long long posicao);
+int gravador_termina(Gravador *g);
+void gravador_libera(Gravador *g);
+
+#endif
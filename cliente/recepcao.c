@@ -0,0 +1,54 @@
+#include "recepcao.h"
+#include <string.h>
+
+// comeca a janela na sequencia do primeiro frame esperado
+void recepcao_inicia(Recepcao *r, uchar primeira)
+{
+    r->proxima = primeira % ESPACO_SEQUENCIA;
+    memset(r->guardados, 0, sizeof(r->guardados));
+}
+
+// devolve ao pool os frames que nao chegaram a ser entregues
+void recepcao_termina(Recepcao *r)
+{
+    for (int i = 0; i < ESPACO_SEQUENCIA; i++)
+    {
+        buffer_solta(r->guardados[i]);
+        r->guardados[i] = NULL;
+    }
+}
+
+// guarda uma referencia a um frame recebido
+// retorna 1 se ele e novo, 0 se e repetido (ja entregue ou ja guardado)
+int recepcao_aceita(Recepcao *r, BufferFrame *frame)
+{
+    // distancia ate a proxima esperada, considerando a volta do contador
+    uchar seq = buffer_sequencia(frame);
+    uchar distancia = (seq - r->proxima + ESPACO_SEQUENCIA) % ESPACO_SEQUENCIA;
+
+    // fora da janela: e uma retransmissao de algo ja entregue
+    if (distancia >= JANELA_RECEPCAO)
+        return 0;
+
+    uchar idx = seq % ESPACO_SEQUENCIA;
+    if (r->guardados[idx])
+        return 0;
+
+    buffer_ref(frame);
+    r->guardados[idx] = frame;
+    return 1;
+}
+
+// retira o proximo frame em ordem, se ele ja chegou (quem chama solta o buffer)
+// retorna NULL se ainda falta o da proxima sequencia
+BufferFrame *recepcao_entrega(Recepcao *r)
+{
+    uchar idx = r->proxima;
+    BufferFrame *frame = r->guardados[idx];
+    if (!frame)
+        return NULL;
+
+    r->guardados[idx] = NULL;
+    r->proxima = (r->proxima + 1) % ESPACO_SEQUENCIA;
+    return frame;
+}
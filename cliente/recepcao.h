@@ -0,0 +1,20 @@
+#ifndef RECEPCAO_H
+#define RECEPCAO_H
+
+#include "protocolo.h"
+#include "buffer.h"
+
+#define JANELA_RECEPCAO 16 // metade do espaco, para distinguir novos de repetidos
+
+// estado do receptor: o que ja foi entregue e o que chegou fora de ordem
+typedef struct {
+    uchar proxima;                              // proxima sequencia a entregar
+    BufferFrame *guardados[ESPACO_SEQUENCIA];   // frames aguardando o buraco ser preenchido
+} Recepcao;
+
+void recepcao_inicia(Recepcao *r, uchar primeira);
+void recepcao_termina(Recepcao *r);
+int recepcao_aceita(Recepcao *r, BufferFrame *frame);
+BufferFrame *recepcao_entrega(Recepcao *r);
+
+#endif
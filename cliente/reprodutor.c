@@ -0,0 +1,220 @@
+#define _GNU_SOURCE // pipe2, F_SETPIPE_SZ
+#include "reprodutor.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "giro.h"
+
+#define PENDENTE_MINIMO 65536
+
+extern char **environ;
+
+// programa de cada tipo de objeto; "-" le da entrada padrao
+static int comando(uchar tipo, const char *arquivo, char *argv[3])
+{
+    const char *programa = tipo == 6 ? "cat" : tipo == 8 ? "feh" : tipo == 7 ? "mpv" : NULL;
+    if (!programa)
+        return -1;
+    argv[0] = (char *)programa;
+    argv[1] = (char *)(arquivo ? arquivo : "-");
+    argv[2] = NULL;
+    return 0;
+}
+
+// visualizadores em segundo plano que ja terminaram
+static void colhe(void)
+{
+    while (waitpid(-1, NULL, WNOHANG) > 0)
+        ;
+}
+
+// entrada do visualizador: o pipe, ou /dev/null para ele nao disputar o teclado com o jogo
+static pid_t inicia(char *argv[], int entrada)
+{
+    posix_spawn_file_actions_t acoes;
+    posix_spawn_file_actions_init(&acoes);
+    if (entrada >= 0)
+        posix_spawn_file_actions_adddup2(&acoes, entrada, STDIN_FILENO);
+    else
+        posix_spawn_file_actions_addopen(&acoes, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+
+    // o visualizador nao herda a CPU presa pelo modo de giro
+    pid_t pid;
+    giro_livre(1);
+    int erro = posix_spawnp(&pid, argv[0], &acoes, NULL, argv, environ);
+    giro_livre(0);
+    posix_spawn_file_actions_destroy(&acoes);
+    if (erro)
+    {
+        fprintf(stderr, "Erro ao iniciar %s: %s\n", argv[0], strerror(erro));
+        return -1;
+    }
+    return pid;
+}
+
+// o visualizador fechou a entrada (EPIPE): o resto do objeto so vai para o arquivo
+static void abandona(Reprodutor *r)
+{
+    close(r->fd);
+    r->fd = -1;
+    free(r->pendente);
+    r->pendente = NULL;
+    r->inicio = r->usado = r->capacidade = 0;
+}
+
+// escreve o que o pipe aceitar agora; retorna quantos bytes foram, -1 se o visualizador fechou
+static ssize_t escreve(Reprodutor *r, const uchar *dados, size_t tamanho)
+{
+    size_t feito = 0;
+    while (feito < tamanho)
+    {
+        ssize_t w = write(r->fd, dados + feito, tamanho - feito);
+        if (w > 0)
+            feito += w;
+        else if (w < 0 && errno == EINTR)
+            continue;
+        else if (w < 0 && errno == EAGAIN)
+            break;
+        else
+            return -1;
+    }
+    return feito;
+}
+
+static void guarda(Reprodutor *r, const uchar *dados, size_t tamanho)
+{
+    if (r->usado + tamanho > r->capacidade)
+    {
+        // reaproveita o comeco ja escrito antes de crescer
+        memmove(r->pendente, r->pendente + r->inicio, r->usado - r->inicio);
+        r->usado -= r->inicio;
+        r->inicio = 0;
+    }
+    if (r->usado + tamanho > r->capacidade)
+    {
+        size_t capacidade = r->capacidade ? 2 * r->capacidade : PENDENTE_MINIMO;
+        while (capacidade < r->usado + tamanho)
+            capacidade *= 2;
+        uchar *maior = realloc(r->pendente, capacidade);
+        if (!maior)
+        {
+            abandona(r);
+            return;
+        }
+        r->pendente = maior;
+        r->capacidade = capacidade;
+    }
+    memcpy(r->pendente + r->usado, dados, tamanho);
+    r->usado += tamanho;
+}
+
+// sobe o visualizador lendo de um pipe; retorna -1 se nao ha visualizador para o tipo
+int reprodutor_inicia(Reprodutor *r, uchar tipo)
+{
+    memset(r, 0, sizeof(*r));
+    r->fd = -1;
+    r->pid = -1;
+    char *argv[3];
+    int p[2];
+    if (comando(tipo, NULL, argv) != 0 || pipe2(p, O_CLOEXEC) != 0)
+        return -1;
+    colhe();
+
+    // um pipe maior absorve as rajadas sem juntar pendentes
+    fcntl(p[1], F_SETPIPE_SZ, PIPE_REPRODUCAO);
+    r->pid = inicia(argv, p[0]);
+    close(p[0]);
+    if (r->pid < 0)
+    {
+        close(p[1]);
+        return -1;
+    }
+    fcntl(p[1], F_SETFL, O_NONBLOCK);
+    r->fd = p[1];
+    r->espera = tipo == 6;
+    return 0;
+}
+
+// entrega mais um pedaco, na ordem do arquivo, sem bloquear
+void reprodutor_envia(Reprodutor *r, const void *dados, size_t tamanho)
+{
+    if (r->fd < 0)
+        return;
+    const uchar *p = dados;
+
+    // o que ja estava pendente sai antes
+    if (r->inicio < r->usado)
+    {
+        ssize_t w = escreve(r, r->pendente + r->inicio, r->usado - r->inicio);
+        if (w < 0)
+        {
+            abandona(r);
+            return;
+        }
+        r->inicio += w;
+        if (r->inicio == r->usado)
+            r->inicio = r->usado = 0;
+    }
+    if (r->inicio == r->usado)
+    {
+        ssize_t w = escreve(r, p, tamanho);
+        if (w < 0)
+        {
+            abandona(r);
+            return;
+        }
+        p += w;
+        tamanho -= w;
+    }
+    if (tamanho)
+        guarda(r, p, tamanho);
+}
+
+// objeto completo: entrega o pendente (agora esperando o visualizador) e fecha a entrada
+void reprodutor_fecha(Reprodutor *r)
+{
+    if (r->fd >= 0)
+    {
+        fcntl(r->fd, F_SETFL, 0);
+        if (r->inicio < r->usado)
+            escreve(r, r->pendente + r->inicio, r->usado - r->inicio);
+        abandona(r);
+    }
+    if (r->espera && r->pid > 0)
+        waitpid(r->pid, NULL, 0);
+    r->pid = -1;
+}
+
+// o objeto nao conferiu: o visualizador nao deve mostrar o resto
+void reprodutor_cancela(Reprodutor *r)
+{
+    if (r->fd >= 0)
+        abandona(r);
+    if (r->pid > 0)
+    {
+        kill(r->pid, SIGTERM);
+        waitpid(r->pid, NULL, 0);
+    }
+    r->pid = -1;
+}
+
+// mostra um arquivo ja completo; o texto e esperado, imagem e video ficam em segundo plano
+int reprodutor_arquivo(uchar tipo, const char *arquivo)
+{
+    char *argv[3];
+    if (comando(tipo, arquivo, argv) != 0)
+        return -1;
+    colhe();
+    pid_t pid = inicia(argv, -1);
+    if (pid < 0)
+        return -1;
+    if (tipo == 6)
+        waitpid(pid, NULL, 0);
+    return 0;
+}
@@ -0,0 +1,28 @@
+#ifndef REPRODUTOR_H
+#define REPRODUTOR_H
+
+#include <stddef.h>
+#include <sys/types.h>
+#include "protocolo.h"
+
+// visualizador do objeto (cat, feh ou mpv), iniciado com posix_spawn, sem shell
+// no modo continuo ele le os dados por um pipe enquanto o objeto ainda chega:
+// o que o pipe nao aceita na hora fica pendente, a recepcao nunca espera o visualizador
+#define PIPE_REPRODUCAO (1 << 20) // tamanho pedido ao kernel para o pipe
+
+typedef struct
+{
+    pid_t pid;
+    int fd;           // entrada do visualizador, -1 sem pipe ou depois de fechada
+    int espera;       // texto: espera o cat terminar, como antes
+    uchar *pendente;  // dados que ainda nao couberam no pipe, de 'inicio' a 'usado'
+    size_t inicio, usado, capacidade;
+} Reprodutor;
+
+int reprodutor_inicia(Reprodutor *r, uchar tipo);
+void reprodutor_envia(Reprodutor *r, const void *dados, size_t tamanho);
+void reprodutor_fecha(Reprodutor *r);
+void reprodutor_cancela(Reprodutor *r);
+int reprodutor_arquivo(uchar tipo, const char *arquivo);
+
+#endif
@@ -0,0 +1,191 @@
+#include "tela.h"
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+#define LINHAS_PADRAO 24 // sem terminal (saida redirecionada)
+#define COLUNAS_PADRAO 80
+#define CELULA_MAX 20    // bytes de uma celula com o movimento do cursor
+
+static int largura, altura;   // mapa
+static int linhas, colunas;   // terminal
+static int janela_l, janela_a; // celulas visiveis
+static int origem_x, origem_y; // celula no canto inferior esquerdo da janela
+static char *anterior;         // simbolo desenhado em cada celula da janela, 0 se nao desenhado
+static char cabecalho[128];
+static int completo = 1;
+
+static char *saida;
+static size_t usado, capacidade;
+
+static void acrescenta(const char *formato, ...) __attribute__((format(printf, 1, 2)));
+static void acrescenta(const char *formato, ...)
+{
+    va_list args;
+    va_start(args, formato);
+    int n = vsnprintf(saida + usado, capacidade - usado, formato, args);
+    va_end(args);
+    if (n > 0)
+        usado += (size_t)n < capacidade - usado ? (size_t)n : capacidade - usado - 1;
+}
+
+// tamanho do terminal; muda a janela e os buffers se mudou
+static int ajusta_terminal(void)
+{
+    struct winsize ws;
+    int l = LINHAS_PADRAO, c = COLUNAS_PADRAO;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_row && ws.ws_col)
+    {
+        l = ws.ws_row;
+        c = ws.ws_col;
+    }
+    if (anterior && l == linhas && c == colunas)
+        return 0;
+
+    linhas = l;
+    colunas = c;
+    janela_l = (colunas - 1) / 3 < largura ? (colunas - 1) / 3 : largura;
+    janela_a = linhas - 3 - LINHAS_MENSAGEM < altura ? linhas - 3 - LINHAS_MENSAGEM : altura;
+    if (janela_l < 1)
+        janela_l = 1;
+    if (janela_a < 1)
+        janela_a = 1;
+
+    free(anterior);
+    free(saida);
+    capacidade = (size_t)janela_l * janela_a * CELULA_MAX + 2 * sizeof(cabecalho) + 256;
+    anterior = calloc((size_t)janela_l * janela_a, 1);
+    saida = malloc(capacidade);
+    completo = 1;
+    return anterior && saida ? 0 : -1;
+}
+
+// move a janela quando o jogador sai dela, deixando ele no meio
+static void segue(int *origem, int jogador, int janela, int lado)
+{
+    if (jogador >= *origem && jogador < *origem + janela)
+        return;
+    *origem = jogador - janela / 2;
+    if (*origem > lado - janela)
+        *origem = lado - janela;
+    if (*origem < 0)
+        *origem = 0;
+}
+
+int tela_inicia(int l, int a)
+{
+    largura = l;
+    altura = a;
+    return ajusta_terminal();
+}
+
+void tela_desenha(const Celulas *percorridas, const Celulas *coletados, Posicao jogador)
+{
+    // o que ja foi impresso sai antes do quadro
+    fflush(stdout);
+    if (ajusta_terminal() != 0)
+        return;
+    segue(&origem_x, jogador.x, janela_l, largura);
+    segue(&origem_y, jogador.y, janela_a, altura);
+
+    usado = 0;
+    if (completo)
+    {
+        // tira a regiao de rolagem anterior e limpa a tela
+        acrescenta("\033[r\033[H\033[J");
+        memset(anterior, 0, (size_t)janela_l * janela_a);
+        cabecalho[0] = '\0';
+    }
+    else
+    {
+        // guarda o cursor da regiao de mensagens
+        acrescenta("\0337");
+    }
+
+    char novo[sizeof(cabecalho)];
+    int n = snprintf(novo, sizeof(novo), "Caça ao Tesouro - Posição: (%d, %d)", jogador.x, jogador.y);
+    if (janela_l < largura || janela_a < altura)
+        snprintf(novo + n, sizeof(novo) - n, " - Janela (%d-%d, %d-%d) de %dx%d", origem_x,
+                 origem_x + janela_l - 1, origem_y, origem_y + janela_a - 1, largura, altura);
+    if (strcmp(novo, cabecalho) != 0)
+    {
+        acrescenta("\033[1;1H%s\033[K", novo);
+        strcpy(cabecalho, novo);
+    }
+
+    // linha de cima da tela e o maior y; celulas vizinhas que mudaram saem sem mover o cursor
+    for (int r = 0; r < janela_a; r++)
+    {
+        int y = origem_y + janela_a - 1 - r;
+        int cursor = -1;
+        for (int i = 0; i < janela_l; i++)
+        {
+            int x = origem_x + i;
+            long long c = x + (long long)y * largura;
+            char simbolo = ' '; // ainda nao passou
+            if (x == jogador.x && y == jogador.y)
+                simbolo = '@';
+            else if (celulas_tem(coletados, c))
+                simbolo = 'X'; // tesouro coletado
+            else if (celulas_tem(percorridas, c))
+                simbolo = '.'; // ja percorrido
+
+            char *antes = &anterior[(size_t)r * janela_l + i];
+            if (*antes == simbolo)
+                continue;
+            if (cursor != i)
+                acrescenta("\033[%d;%dH", r + 2, 2 + 3 * i);
+            acrescenta("[%c]", simbolo);
+            *antes = simbolo;
+            cursor = i + 1;
+        }
+    }
+
+    if (completo)
+    {
+        // a saida do resto do programa rola abaixo do grid (a regiao tambem leva o cursor ao topo)
+        acrescenta("\033[%d;1HLegenda: @=Você, X=Tesouro Coletado, .=Percorrido", janela_a + 2);
+        if (janela_a + 3 < linhas)
+            acrescenta("\033[%d;%dr", janela_a + 3, linhas);
+        acrescenta("\033[%d;1H", janela_a + 3);
+    }
+    else
+    {
+        acrescenta("\0338");
+    }
+    completo = 0;
+
+    // um write() por quadro; so repete se o terminal aceitou parte
+    const char *p = saida;
+    while (usado > 0)
+    {
+        ssize_t w = write(STDOUT_FILENO, p, usado);
+        if (w < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        p += w;
+        usado -= w;
+    }
+}
+
+// devolve a rolagem ao terminal inteiro, com o cursor no fim
+void tela_termina(void)
+{
+    if (!anterior)
+        return;
+    fflush(stdout);
+    char fim[32];
+    int n = snprintf(fim, sizeof(fim), "\033[r\033[%d;1H\n", linhas);
+    if (write(STDOUT_FILENO, fim, n) < 0)
+        perror("tela");
+    free(anterior);
+    free(saida);
+    anterior = saida = NULL;
+}
@@ -0,0 +1,17 @@
+#ifndef TELA_H
+#define TELA_H
+
+#include "protocolo.h"
+#include "mapa.h"
+
+// desenho do grid no terminal por diferenca: guarda o ultimo quadro e so reescreve as celulas
+// que mudaram, com enderecamento do cursor, num unico write() por atualizacao
+// o grid fica fixo no topo; o resto da saida rola na regiao abaixo dele
+// mapas maiores que o terminal aparecem por uma janela que acompanha o jogador
+#define LINHAS_MENSAGEM 8 // minimo de linhas para a saida abaixo do grid
+
+int tela_inicia(int largura, int altura);
+void tela_desenha(const Celulas *percorridas, const Celulas *coletados, Posicao jogador);
+void tela_termina(void);
+
+#endif
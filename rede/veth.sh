@@ -0,0 +1,49 @@
+#!/bin/sh
+# pares veth para testar o modo multi-enlace (enlaces.h) numa maquina so
+# o lado do servidor fica no namespace $NS, o do cliente no namespace atual
+#
+#   rede/veth.sh cria N                   N pares: sw0s..sw<N-1>s no namespace, sw0c.. aqui
+#   rede/veth.sh lento I TAXA             limita o par I nos dois sentidos, ex.: lento 1 4mbit
+#   rede/veth.sh derruba I | levanta I    tira o par I do ar no meio de um objeto, e volta
+#   rede/veth.sh remove
+#
+# depois, de servidor/ e de cliente/ (como root):
+#   ip netns exec stopwait ../build/debug/servidor -i sw0s,sw1s
+#   ../build/debug/cliente -i sw0c,sw1c
+
+NS=${NS:-stopwait}
+
+case "$1" in
+cria)
+    ip netns add $NS || exit 1
+    i=0
+    while [ $i -lt "${2:-2}" ]; do
+        ip link add sw${i}c type veth peer name sw${i}s || exit 1
+        ip link set sw${i}s netns $NS
+        ip link set sw${i}c up
+        ip -n $NS link set sw${i}s up
+        i=$((i + 1))
+    done
+    ip -n $NS link set lo up
+    ;;
+lento)
+    tc qdisc replace dev sw$2c root tbf rate $3 burst 4kb latency 20ms
+    ip netns exec $NS tc qdisc replace dev sw$2s root tbf rate $3 burst 4kb latency 20ms
+    ;;
+derruba)
+    ip link set sw$2c down
+    ;;
+levanta)
+    ip link set sw$2c up
+    ;;
+remove)
+    for l in $(ip -o link show | sed -n 's/^[0-9]*: \(sw[0-9]*c\)@.*/\1/p'); do
+        ip link del $l
+    done
+    ip netns del $NS
+    ;;
+*)
+    sed -n '2,14s/^# \{0,1\}//p' "$0"
+    exit 1
+    ;;
+esac
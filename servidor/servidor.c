@@ -14,187 +14,531 @@
 #include <sys/socket.h>
 #include <sys/ioctl.h>
 #include "protocolo.h"
+#include "fec.h"
+#include "congestionamento.h"
+#include "buffer.h"
+#include "uring.h"
+#include "config.h"
+#include "sessao.h"
+#include "resumo.h"
+#include "mapa.h"
+#include "registro.h"
+#include "batimento.h"
+#include "enlaces.h"
 
-#define INTERFACE "enp0s31f6" // interface
-#define TIMEOUT_ACK 2000      // 2 segundos
+// objetos/1 a objetos/OBJETOS; o tesouro i leva o objeto i % OBJETOS
+#define OBJETOS 8
+// mapas e listas maiores que isso so aparecem resumidos no terminal do servidor
+#define MOSTRA_LADO 32
+#define MOSTRA_TESOUROS 16
+// um objeto aquecido ha menos que isso nao e pedido ao disco de novo
+#define REAQUECE_MS 10000
+// movimentos ate essa distancia atras do ultimo sao retransmissoes, como na janela de recepcao
+#define JANELA_MOVIMENTOS (ESPACO_SEQUENCIA / 2)
 
 // codigos de erro
 #define ERRO_SEM_PERMISSAO 0
 #define ERRO_ESPACO_INSUFICIENTE 1
 #define ERRO_MOVIMENTO_INVALIDO 2
 
-// struct para os tesouros do mapa
+// leitura do objeto em pedacos, direto nos buffers de envio
+// com io_uring o pedaco seguinte ja esta sendo lido enquanto o atual vai pela rede
 typedef struct
 {
-    int x, y;
-    int coletado;
-} Tesouro;
+    FILE *f;
+    int anel;
+    int tamanho;           // bytes por pedaco
+    long long posicao;     // offset do proximo pedaco a pedir
+    BufferFrame *seguinte; // leitura ja submetida, ou NULL
+} Leitor;
 
-Tesouro tesouros[8];              // lista de 8 tesouros
+// resumo do conteudo de um objeto para o anuncio, refeito so quando o arquivo muda
+typedef struct
+{
+    int algoritmo;
+    off_t tamanho;
+    time_t modificado;
+    uchar resumo[RESUMO_MAX];
+    long long aquecido_ns; // ultimo pedido de leitura antecipada (aquece_objeto)
+} Objeto;
+
+Mapa mapa;                        // tesouros enterrados e coletados
+Objeto objetos[OBJETOS];
 int jogador_x = 0, jogador_y = 0; // posicao do jogador
 uchar sequencia = 0;              // sequencia dos frames
+int ultimo_objeto = -1;           // ultimo objeto enviado, para o cliente pedir de novo
+uchar cliente[6];                 // MAC do cliente da sessao atual
+int tem_cliente = 0;              // ha uma sessao, acompanhada pelo detector de falha
+ConfigFEC fec;                    // correcao de erros das transferencias, da configuracao
+int ultimo_movimento = -1;        // sequencia do ultimo movimento aplicado, -1 no inicio da sessao
+int movimento_aceito = 0;         // o ultimo movimento ficou dentro do grid
+int resposta_entregue = 0;        // o cliente confirmou a resposta ao ultimo movimento
 
 // mostra o grid no servidor, informando onde estao cada tesouro
+// mapas grandes nao sao desenhados, o custo por movimento nao cresce com o mapa
 void mostra_grid_servidor()
 {
-    printf("\n--- Mapa do Servidor ---\n");
-    for (int j = 7; j >= 0; j--)
+    if (mapa.largura > MOSTRA_LADO || mapa.altura > MOSTRA_LADO)
+        return;
+    registra(REG_INFO, "%s", "");
+    registra(REG_INFO, "--- Mapa do Servidor ---");
+    for (int j = mapa.altura - 1; j >= 0; j--)
     {
-        printf(" ");
-        for (int i = 0; i < 8; i++)
+        // uma linha por registro
+        char linha[2 + 3 * MOSTRA_LADO];
+        char *p = linha;
+        *p++ = ' ';
+        for (int i = 0; i < mapa.largura; i++)
         {
             if (i == jogador_x && j == jogador_y)
             {
-                printf("[@]");
+                memcpy(p, "[@]", 3);
             }
             else
             {
                 // verifica se tem tesouro nao coletado na celula
-                int tem_tesouro = 0;
-                for (int k = 0; k < 8; k++)
-                {
-                    if (tesouros[k].x == i && tesouros[k].y == j && !tesouros[k].coletado)
-                    {
-                        tem_tesouro = 1;
-                        break;
-                    }
-                }
-                printf(tem_tesouro ? "[X]" : "[ ]");
+                memcpy(p, celulas_tem(&mapa.restantes, mapa_celula(&mapa, i, j)) ? "[X]" : "[ ]", 3);
             }
+            p += 3;
         }
-        printf("\n");
+        *p = '\0';
+        registra(REG_INFO, "%s", linha);
     }
-    printf("Legenda: @=Jogador, X=Tesouro\n");
+    registra(REG_INFO, "Legenda: @=Jogador, X=Tesouro");
 }
 
-// posiciona aleatoriamente 8 tesouros no grid
-void inicializa_tesouros()
+// enterra os tesouros em posicoes aleatorias do mapa
+int inicializa_tesouros()
 {
-    srand(time(NULL));
-    int count = 0;
+    return mapa_inicia(&mapa, config.largura, config.altura, config.tesouros, (uint64_t)time(NULL));
+}
 
-    while (count < 8)
+// pede ao anel o proximo pedaco do arquivo
+BufferFrame *leitor_submete(Leitor *l)
+{
+    BufferFrame *b = buffer_aloca();
+    if (b && uring_le(fileno(l->f), b, l->posicao, l->tamanho) != 0)
     {
-        int x = rand() % 8;
-        int y = rand() % 8;
-        int repetido = 0;
+        buffer_solta(b);
+        return NULL;
+    }
+    l->posicao += l->tamanho;
+    return b;
+}
 
-        // verifica se essa posicao ja tem tesouro "enterrado"
-        for (int j = 0; j < count; j++)
+void leitor_inicia(Leitor *l, int sock, FILE *f, int tamanho)
+{
+    l->f = f;
+    l->anel = uring_ativo(sock);
+    l->tamanho = tamanho;
+    l->posicao = 0;
+    l->seguinte = l->anel ? leitor_submete(l) : NULL;
+}
+
+// devolve um buffer com o proximo pedaco em buffer_dados, ou NULL no fim do arquivo
+BufferFrame *leitor_proximo(Leitor *l, size_t *lidos)
+{
+    BufferFrame *b;
+    if (!l->anel)
+    {
+        b = buffer_aloca();
+        if (b && (*lidos = fread(buffer_dados(b), 1, l->tamanho, l->f)) == 0)
         {
-            if (tesouros[j].x == x && tesouros[j].y == y)
-            {
-                repetido = 1;
-                break;
-            }
+            buffer_solta(b);
+            b = NULL;
         }
+        return b;
+    }
 
-        // se nao, "enterra" tesouro
-        if (!repetido)
+    b = l->seguinte;
+    l->seguinte = NULL;
+    if (!b)
+        return NULL;
+    int n = uring_espera_leitura(b);
+    if (n <= 0)
+    {
+        buffer_solta(b);
+        return NULL;
+    }
+    *lidos = n;
+    // pedaco incompleto e o fim do arquivo
+    if (n == l->tamanho)
+        l->seguinte = leitor_submete(l);
+    return b;
+}
+
+void leitor_termina(Leitor *l)
+{
+    if (l->seguinte)
+    {
+        uring_espera_leitura(l->seguinte);
+        buffer_solta(l->seguinte);
+        l->seguinte = NULL;
+    }
+}
+
+// envia o conteudo em grupos de frames seguidos das suas paridades
+// o cliente reconstroi as perdas do grupo sem esperar retransmissao
+int envia_conteudo_fec(int sock, FILE *f, uchar *seq, const uchar *mac_dest, Resumo *resumo)
+{
+    BufferFrame *grupo[FEC_MAX_DADOS];
+    BufferFrame *paridades[FEC_MAX_PARIDADE];
+    int ret = 0;
+    // o frame de dados leva o cabecalho da paridade junto, sem passar do payload da sessao
+    int tamanho = config.tamanho_dados - FEC_CABECALHO - 1;
+    Leitor leitor;
+    leitor_inicia(&leitor, sock, f, tamanho < FEC_DADOS_POR_FRAME ? tamanho : FEC_DADOS_POR_FRAME);
+
+    while (ret == 0)
+    {
+        // le ate n pedacos direto nos buffers de envio, cada um com a sua sequencia
+        int n = 0;
+        size_t lidos;
+        while (n < fec.n && (grupo[n] = leitor_proximo(&leitor, &lidos)) != NULL)
         {
-            tesouros[count].x = x;
-            tesouros[count].y = y;
-            tesouros[count].coletado = 0;
-            count++;
+            resumo_atualiza(resumo, buffer_dados(grupo[n]), lidos);
+            *seq = (*seq + 1) % 32;
+            buffer_monta(grupo[n], *seq, 5, buffer_dados(grupo[n]), lidos);
+            n++;
+        }
+        if (n == 0)
+            break;
+
+        int k = fec_codifica(&fec, grupo, n, paridades);
+        int perdidos = enviar_grupo_com_ack(sock, grupo, n, paridades, k, mac_dest, config.timeout_ms);
+        if (perdidos < 0)
+            ret = -1; // o cliente nao confirmou o grupo, o resto do objeto nao vai
+        else
+            fec_ajusta(&fec, perdidos, n);
+
+        for (int i = 0; i < n; i++)
+            buffer_solta(grupo[i]);
+        for (int j = 0; j < k; j++)
+            buffer_solta(paridades[j]);
+    }
+    leitor_termina(&leitor);
+    return ret;
+}
+
+// envia o conteudo em grupos espalhados pelos enlaces (enlaces.h), cada frame no enlace
+// que deve confirma-lo primeiro; o cliente reordena pela sequencia
+int envia_conteudo_enlaces(int sock, FILE *f, uchar *seq, const uchar *mac_dest, Resumo *resumo)
+{
+    BufferFrame *grupo[ENLACES_GRUPO];
+    int ret = 0;
+    Leitor leitor;
+    leitor_inicia(&leitor, sock, f, config.tamanho_dados);
+
+    while (ret == 0)
+    {
+        int n = 0;
+        size_t lidos;
+        while (n < ENLACES_GRUPO && (grupo[n] = leitor_proximo(&leitor, &lidos)) != NULL)
+        {
+            resumo_atualiza(resumo, buffer_dados(grupo[n]), lidos);
+            *seq = (*seq + 1) % 32;
+            buffer_monta(grupo[n], *seq, 5, buffer_dados(grupo[n]), lidos);
+            n++;
+        }
+        if (n == 0)
+            break;
+
+        if (enlaces_envia_grupo(grupo, n, mac_dest, config.timeout_ms) < 0)
+            ret = -1;
+        for (int i = 0; i < n; i++)
+            buffer_solta(grupo[i]);
+    }
+    leitor_termina(&leitor);
+    return ret;
+}
+
+// resumo do conteudo do objeto, que vai no anuncio para o cliente procurar no cache dele
+// guardado por tesouro enquanto tamanho e data de modificacao nao mudam
+int resumo_conteudo(int num_objeto, const char *caminho, const struct stat *st, uchar *saida)
+{
+    Objeto *t = &objetos[num_objeto];
+    if (config.resumo == RESUMO_NENHUM)
+        return 0;
+    if (t->algoritmo != config.resumo || t->tamanho != st->st_size || t->modificado != st->st_mtime)
+    {
+        if (resumo_arquivo(caminho, config.resumo, t->resumo) < 0)
+            return 0;
+        t->algoritmo = config.resumo;
+        t->tamanho = st->st_size;
+        t->modificado = st->st_mtime;
+    }
+    int n = resumo_tamanho(t->algoritmo);
+    memcpy(saida, t->resumo, n);
+    return n;
+}
+
+// extensoes possiveis dos objetos, na ordem em que sao procuradas, e o tipo do anuncio de cada
+static const char *extensoes[] = {".txt", ".jpg", ".mp4"};
+static const uchar tipos[] = {6, 8, 7};
+
+// caminho do arquivo do objeto pela primeira extensao que existir
+// retorna o indice da extensao, ou -1 se o objeto nao existe
+int caminho_objeto(int num_objeto, char *caminho, size_t tamanho, struct stat *st)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        snprintf(caminho, tamanho, "objetos/%d%s", num_objeto + 1, extensoes[i]);
+        if (stat(caminho, st) == 0)
+            return i;
+    }
+    return -1;
+}
+
+// pede ao kernel para trazer o objeto do disco em segundo plano (readahead)
+// quando o jogador chegar no tesouro o anuncio e o envio ja leem da memoria
+void aquece_objeto(int num_objeto)
+{
+    Objeto *t = &objetos[num_objeto];
+    long long agora = timestamp_ns();
+    if (t->aquecido_ns && agora - t->aquecido_ns < REAQUECE_MS * 1000000LL)
+        return;
+    char caminho[128];
+    struct stat st;
+    if (caminho_objeto(num_objeto, caminho, sizeof(caminho), &st) < 0)
+        return;
+    int fd = open(caminho, O_RDONLY);
+    if (fd < 0)
+        return;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+    close(fd);
+    t->aquecido_ns = agora;
+    registra(REG_DEPURA, "Aquecendo o objeto %d (%s)", num_objeto + 1, caminho);
+}
+
+// aquece os objetos dos tesouros nao coletados a ate config.aquece passos do jogador
+// percorre so o losango de celulas em volta dele, o custo nao depende do mapa
+void aquece_vizinhanca()
+{
+    int d = config.aquece;
+    for (int dy = -d; dy <= d; dy++)
+    {
+        int resto = d - abs(dy);
+        for (int dx = -resto; dx <= resto; dx++)
+        {
+            int x = jogador_x + dx, y = jogador_y + dy;
+            if (!mapa_dentro(&mapa, x, y) || !celulas_tem(&mapa.restantes, mapa_celula(&mapa, x, y)))
+                continue;
+            aquece_objeto(mapa_tesouro(&mapa, x, y) % OBJETOS);
         }
     }
 }
 
 // envia o arquivo associado ao tesouro encontrado
-void envia_arquivo(int sock, int num_tesouro, uchar seq, const uchar *mac_dest)
+// retorna 0 se o cliente ficou com o objeto
+int envia_arquivo(int sock, int num_objeto, uchar seq, const uchar *mac_dest)
 {
     // verifica permissao de leitura dos objetos
     if (access("objetos", R_OK) != 0)
     {
         uchar codigo_erro = ERRO_SEM_PERMISSAO;
         Frame erro = criar_frame(seq, 15, &codigo_erro, 1);
-        enviar_com_ack(sock, &erro, mac_dest, TIMEOUT_ACK);
-        return;
+        enviar_com_ack(sock, &erro, mac_dest, config.timeout_ms);
+        return -1;
     }
 
-    // tipos possiveis
-    const char *extensoes[] = {".txt", ".jpg", ".mp4"};
-    uchar tipos[] = {6, 8, 7};
+    // acha o arquivo do objeto, pela primeira extensao que existir
     char caminho[128];
+    struct stat st;
+    int i = caminho_objeto(num_objeto, caminho, sizeof(caminho), &st);
+    if (i < 0)
+        return -1;
 
-    // verifica cada extensao ate encontrar o arquivo
-    for (int i = 0; i < 3; i++)
+    // envia o frame contendo o nome do arquivo e, depois do '\0', o algoritmo e o resumo
+    // do conteudo; o cliente responde TIPO_TEM se ja tem esse conteudo no cache
+    const char *nome = strrchr(caminho, '/');
+    nome = nome ? nome + 1 : caminho;
+    uchar anuncio[MAX_DADOS];
+    size_t tamanho_nome = strlen(nome);
+    memcpy(anuncio, nome, tamanho_nome + 1);
+    anuncio[tamanho_nome + 1] = config.resumo;
+    int tamanho_anuncio = tamanho_nome + 2;
+    tamanho_anuncio += resumo_conteudo(num_objeto, caminho, &st, anuncio + tamanho_anuncio);
+    Frame f_nome = criar_frame(seq, tipos[i], anuncio, tamanho_anuncio);
+    if (enviar_com_ack(sock, &f_nome, mac_dest, config.timeout_ms) == 1)
     {
-        snprintf(caminho, sizeof(caminho), "objetos/%d%s", num_tesouro + 1, extensoes[i]);
-        struct stat st;
-        if (stat(caminho, &st) == 0)
-        {
-            // envia o frame contendo o nome do arquivo
-            const char *nome = strrchr(caminho, '/');
-            nome = nome ? nome + 1 : caminho;
-            Frame f_nome = criar_frame(seq, tipos[i], (uchar *)nome, strlen(nome));
-            enviar_com_ack(sock, &f_nome, mac_dest, TIMEOUT_ACK);
-
-            // abre o arquivo
-            FILE *f = fopen(caminho, "rb");
-            if (!f)
-                return;
-
-            // envia o conteudo em "pedacos" de ate 127 bytes
-            uchar buffer[127];
-            size_t lidos;
-            while ((lidos = fread(buffer, 1, sizeof(buffer), f)) > 0)
-            {
-                Frame f_dados = criar_frame(seq, 5, buffer, lidos);
-                enviar_com_ack(sock, &f_dados, mac_dest, TIMEOUT_ACK);
-            }
+        registra(REG_INFO, "Cliente ja tem o objeto %d, nada a enviar", num_objeto + 1);
+        ultimo_objeto = num_objeto;
+        return 0;
+    }
 
-            // envia o frame de fim de arquivo (tipo = 9)
-            Frame f_fim = criar_frame(seq, 9, NULL, 0);
-            enviar_com_ack(sock, &f_fim, mac_dest, TIMEOUT_ACK);
-            fclose(f);
+    // abre o arquivo
+    FILE *f = fopen(caminho, "rb");
+    if (!f)
+        return -1;
 
-            // marca o tesouro como coletado
-            tesouros[num_tesouro].coletado = 1;
-            break;
-        }
-    }
-}
+    // resumo calculado sobre os pedacos lidos, sem ler o arquivo de novo
+    Resumo resumo;
+    resumo_inicia(&resumo, config.resumo);
 
-// retorna o indice do tesouro na posicao x,y se existir E nao coletado
-// caso contrario, -1
-int verifica_tesouro(int x, int y)
-{
-    for (int i = 0; i < 8; i++)
+    // com varios enlaces os dados se espalham por eles, e a FEC fica so para um enlace
+    int falhou = 0;
+    long long inicio = timestamp_ns();
+    if (n_enlaces > 1)
     {
-        if (!tesouros[i].coletado &&
-            tesouros[i].x == x &&
-            tesouros[i].y == y)
+        enlaces_colhe(); // apresentacoes do cliente que chegaram enquanto esperavamos o movimento
+        falhou = envia_conteudo_enlaces(sock, f, &seq, mac_dest, &resumo) != 0;
+    }
+    else if (fec.modo != FEC_DESLIGADO)
+    {
+        falhou = envia_conteudo_fec(sock, f, &seq, mac_dest, &resumo) != 0;
+    }
+    else
+    {
+        // envia o conteudo em "pedacos" do payload da sessao, lidos direto no buffer de envio
+        // cada frame leva a sua sequencia, para o cliente descartar repetidos
+        Leitor leitor;
+        leitor_inicia(&leitor, sock, f, config.tamanho_dados);
+        BufferFrame *b;
+        size_t lidos;
+        while ((b = leitor_proximo(&leitor, &lidos)) != NULL)
         {
-            return i;
+            resumo_atualiza(&resumo, buffer_dados(b), lidos);
+            seq = (seq + 1) % 32;
+            buffer_monta(b, seq, 5, buffer_dados(b), lidos);
+            falhou = enviar_buffer_com_ack(sock, b, mac_dest, config.timeout_ms) < 0;
+            buffer_solta(b);
+            if (falhou)
+                break;
         }
+        leitor_termina(&leitor);
     }
-    return -1;
+
+    // o cliente parou de confirmar: o objeto e abortado, sem o fim
+    if (falhou)
+    {
+        registra(REG_AVISO, "Envio do objeto %d abortado", num_objeto + 1);
+        fclose(f);
+        return -1;
+    }
+
+    // envia o frame de fim de arquivo (tipo = 9), com {algoritmo, resumo}
+    // com varios enlaces ele tambem vai pela escala, o primeiro pode ter caido no meio do objeto
+    seq = (seq + 1) % 32;
+    uchar fim[1 + RESUMO_MAX];
+    fim[0] = config.resumo;
+    int tamanho_fim = 1 + resumo_final(&resumo, fim + 1);
+    Frame f_fim = criar_frame(seq, 9, fim, tamanho_fim);
+    if (n_enlaces > 1)
+    {
+        BufferFrame *b = buffer_de_frame(&f_fim);
+        if (b)
+            enlaces_envia_grupo(&b, 1, mac_dest, config.timeout_ms);
+        buffer_solta(b);
+        enlaces_mostra(timestamp_ns() - inicio);
+    }
+    else
+    {
+        enviar_com_ack(sock, &f_fim, mac_dest, config.timeout_ms);
+    }
+    fclose(f);
+
+    ultimo_objeto = num_objeto;
+    cc_mostra(par_busca(mac_dest));
+    return 0;
+}
+
+// o detector deu o cliente por morto: libera o estado do par e volta o jogo ao inicio,
+// o proximo cliente comeca uma sessao nova
+void encerra_sessao()
+{
+    Par *par = par_busca(cliente);
+    registra(REG_AVISO, "Cliente %02x:%02x:%02x:%02x:%02x:%02x sem sinal de vida (phi %.1f), sessao encerrada",
+             cliente[0], cliente[1], cliente[2], cliente[3], cliente[4], cliente[5],
+             batimento_phi(par, timestamp_ns()));
+    par_esquece(par);
+    enlaces_esquece();
+    tem_cliente = 0;
+    jogador_x = jogador_y = 0;
+    ultimo_objeto = -1;
+    ultimo_movimento = -1;
 }
 
 // exibe a posicao do jogador e os status dos tesouros
+// com muitos tesouros so a contagem, a lista custaria um registro por tesouro a cada movimento
 void mostra_status()
 {
-    printf("\n--- Status ---\n");
-    printf("Jogador: (%d, %d)\n", jogador_x, jogador_y);
-    printf("Tesouros:\n");
-    for (int i = 0; i < 8; i++)
+    registra(REG_INFO, "%s", "");
+    registra(REG_INFO, "--- Status ---");
+    registra(REG_INFO, "Jogador: (%d, %d)", jogador_x, jogador_y);
+    registra(REG_INFO, "Tesouros: %d de %d disponiveis", mapa.restam, mapa.tesouros);
+    for (int i = 0; i < mapa.tesouros && mapa.tesouros <= MOSTRA_TESOUROS; i++)
     {
-        printf("  %d: (%d, %d) %s\n", i + 1, tesouros[i].x, tesouros[i].y,
-               tesouros[i].coletado ? "[Coletado]" : "[Disponível]");
+        int x, y;
+        int disponivel = mapa_posicao(&mapa, i, &x, &y);
+        registra(REG_INFO, "  %d: (%d, %d) %s", i + 1, x, y, disponivel ? "[Disponível]" : "[Coletado]");
     }
-    printf("--------------\n");
+    registra(REG_INFO, "--------------");
 }
 
-int main()
+// responde ao ultimo movimento, na posicao atual: erro se ele saia do grid, o objeto se ha
+// um tesouro ali, ou um ACK; tambem serve para repetir a resposta a uma retransmissao dele
+// retorna 0 se o cliente confirmou a resposta
+int responde_movimento(int sock, uchar seq, const uchar *mac_dest)
 {
+    // se o movimento for para fora do grid, retorna erro
+    if (!movimento_aceito)
+    {
+        uchar codigo_erro = ERRO_MOVIMENTO_INVALIDO;
+        Frame erro = criar_frame(seq, 15, &codigo_erro, 1);
+        return enviar_com_ack(sock, &erro, mac_dest, config.timeout_ms) < 0 ? -1 : 0;
+    }
+
+    // se "encontrar" o tesou, envia o arquivo
+    int idx_tesouro = mapa_tesouro(&mapa, jogador_x, jogador_y);
+    if (idx_tesouro != -1)
+    {
+        if (envia_arquivo(sock, idx_tesouro % OBJETOS, seq, mac_dest) != 0)
+            return -1;
+        // marca o tesouro como coletado
+        mapa_coleta(&mapa, jogador_x, jogador_y);
+        return 0;
+    }
+
+    // caso contrario, envia ACK
+    Frame ack = criar_frame(seq, 0, NULL, 0);
+    return enviar_com_ack(sock, &ack, mac_dest, config.timeout_ms) < 0 ? -1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    // parametros da sessao: arquivo e linha de comando, depois o acordo com o cliente
+    if (config_le(&config, argc, argv) != 0)
+        return 1;
+    // a redundancia parte da configurada e segue a perda medida, se adaptativa
+    fec = (ConfigFEC){config.fec, config.fec_grupo, config.fec_paridades, config.fec_adaptativo, 0.0};
+
+    // as mensagens saem por uma thread de fundo, o terminal nao atrasa as respostas
+    registro_inicia(config.registro);
+
     // cria o raw socket
-    int sock = cria_raw_socket(INTERFACE);
+    int sock = cria_raw_socket(config.interface);
+    cc_configura(config.controle, config.janela);
+    if (config.uring && uring_inicia(sock) == 0)
+        registra(REG_INFO, "Usando io_uring");
+    // um socket por interface a mais; o anel fica com o primeiro
+    if (enlaces_abre(sock) > 1)
+        registra(REG_INFO, "Objetos espalhados por %d enlaces", n_enlaces);
     // inicializa os tesouros
-    inicializa_tesouros();
+    if (inicializa_tesouros() != 0)
+    {
+        registra(REG_ERRO, "Erro ao criar o mapa %dx%d", config.largura, config.altura);
+        registro_termina();
+        return 1;
+    }
 
-    printf("Servidor iniciado. Aguardando movimentos...\n");
+    registra(REG_INFO, "Servidor iniciado. Aguardando movimentos...");
     mostra_status();
+    aquece_vizinhanca();
+
+    // com o detector ligado a espera acorda a cada batimento, para mandar o nosso e
+    // conferir se o cliente ainda esta vivo
+    int espera_ms = config.batimento_ms > 0 && config.batimento_ms < config.timeout_ms ? config.batimento_ms
+                                                                                       : config.timeout_ms;
 
     // loop principal, processa os frames recebidos do cliente
     while (1)
@@ -202,14 +546,74 @@ int main()
         Frame recebido;
         uchar mac_cliente[6];
 
-        if (receber_com_ack(sock, &recebido, mac_cliente, TIMEOUT_ACK) == 0)
+        enlaces_colhe();
+        if (tem_cliente)
+        {
+            batimento_pulsa(sock, cliente);
+            if (batimento_falhou(par_busca(cliente)))
+                encerra_sessao();
+        }
+
+        if (receber_com_ack(sock, &recebido, mac_cliente, espera_ms) == 0)
         {
+            // outro cliente comeca do zero a contagem dos movimentos
+            if (tem_cliente && memcmp(cliente, mac_cliente, 6) != 0)
+                ultimo_movimento = -1;
+            memcpy(cliente, mac_cliente, 6);
+            tem_cliente = 1;
+
+            // batimento do cliente ocioso, ja contado pelo detector
+            if (recebido.tipo == TIPO_BATIMENTO)
+                continue;
+
+            // sondagem do cliente: eco, e o acordo final vale para a sessao
+            if (recebido.tipo == TIPO_SONDA)
+            {
+                if (sessao_responde(sock, &recebido, mac_cliente, &config))
+                {
+                    cc_configura(config.controle, config.janela);
+                    config_mostra(&config);
+                    ultimo_movimento = -1;
+                }
+                continue;
+            }
+
+            // o cliente recebeu o ultimo objeto diferente do enviado: manda so ele de novo
+            if (recebido.tipo == 15)
+            {
+                if (recebido.tamanho >= 1 && recebido.dados[0] == ERRO_RESUMO && ultimo_objeto >= 0)
+                {
+                    registra(REG_INFO, "Resumo nao confere no cliente, reenviando o objeto %d", ultimo_objeto + 1);
+                    envia_arquivo(sock, ultimo_objeto, recebido.sequencia, mac_cliente);
+                }
+                continue;
+            }
+
+            // daqui em diante so movimentos; um ACK atrasado nao anda o jogador
+            if (recebido.tipo < 10 || recebido.tipo > 13)
+                continue;
+
+            // o cliente reenvia o movimento quando o ACK dele se perde: a retransmissao ja
+            // recebeu o ACK de novo, e so repete a resposta se a primeira nao chegou
+            // os mais antigos que ainda cheguem tambem nao andam o jogador
+            int atras = (ultimo_movimento - recebido.sequencia + ESPACO_SEQUENCIA) % ESPACO_SEQUENCIA;
+            if (ultimo_movimento >= 0 && atras < JANELA_MOVIMENTOS)
+            {
+                if (atras == 0 && !resposta_entregue)
+                {
+                    registra(REG_INFO, "Movimento %d repetido, reenviando a resposta", recebido.sequencia);
+                    resposta_entregue = responde_movimento(sock, recebido.sequencia, mac_cliente) == 0;
+                }
+                continue;
+            }
+            ultimo_movimento = recebido.sequencia;
+
             // processa o movimento
             int movimento_valido = 1;
             switch (recebido.tipo)
             {
             case 10: // direita
-                if (jogador_x >= 7)
+                if (jogador_x >= mapa.largura - 1)
                 {
                     movimento_valido = 0;
                 }
@@ -219,7 +623,7 @@ int main()
                 }
                 break;
             case 11: // cima
-                if (jogador_y >= 7)
+                if (jogador_y >= mapa.altura - 1)
                 {
                     movimento_valido = 0;
                 }
@@ -249,36 +653,26 @@ int main()
                 }
                 break;
             }
+            movimento_aceito = movimento_valido;
 
-            // se o movimento for para fora do grid, retorna erro
-            if (!movimento_valido)
+            // atualiza o mapa e os status
+            if (movimento_valido)
             {
-                uchar codigo_erro = ERRO_MOVIMENTO_INVALIDO;
-                Frame erro = criar_frame(recebido.sequencia, 15, &codigo_erro, 1);
-                enviar_com_ack(sock, &erro, mac_cliente, TIMEOUT_ACK);
-                continue;
+                mostra_grid_servidor();
+                mostra_status();
             }
 
-            // atualiza o mapa e os status
-            mostra_grid_servidor();
-            mostra_status();
+            resposta_entregue = responde_movimento(sock, recebido.sequencia, mac_cliente) == 0;
 
-            // se "encontrar" o tesou, envia o arquivo
-            int idx_tesouro = verifica_tesouro(jogador_x, jogador_y);
-            if (idx_tesouro != -1)
-            {
-                envia_arquivo(sock, idx_tesouro, recebido.sequencia, mac_cliente);
-            }
-            else
-            {
-                // caso contrario, envia ACK
-                Frame ack = criar_frame(recebido.sequencia, 0, NULL, 0);
-                enviar_com_ack(sock, &ack, mac_cliente, TIMEOUT_ACK);
-            }
+            // com a resposta ja enviada, adianta a leitura dos tesouros proximos
+            if (movimento_valido)
+                aquece_vizinhanca();
         }
     }
 
     // ao final, fecha o socket e sai
+    registro_termina();
+    uring_termina();
     close(sock);
     return 0;
 }
@@ -0,0 +1,60 @@
+#include "batimento.h"
+#include "buffer.h"
+#include "config.h"
+#include <math.h>
+
+// frame valido do par: uma amostra do intervalo entre sinais de vida
+void batimento_ouvido(Par *p, long long agora_ns)
+{
+    if (p->ouvido_ns == 0)
+    {
+        // antes da primeira amostra espera-se um batimento por intervalo
+        p->intervalo_ns = config.batimento_ms * 1e6;
+        p->intervalo_var = 0;
+    }
+    else
+    {
+        // medias moveis, como as do RTT
+        double intervalo = agora_ns - p->ouvido_ns;
+        double desvio = intervalo - p->intervalo_ns;
+        p->intervalo_ns += desvio / 8;
+        p->intervalo_var += (desvio * desvio - p->intervalo_var) / 8;
+    }
+    p->ouvido_ns = agora_ns;
+}
+
+// manda um batimento se o par nao recebe nada nosso ha meio intervalo
+void batimento_pulsa(int sock, const uchar *mac)
+{
+    if (config.batimento_ms <= 0)
+        return;
+    Par *p = par_busca(mac);
+    if (p->usado_ns - p->enviado_ns < config.batimento_ms * 500000LL)
+        return;
+    BufferFrame *b = buffer_aloca();
+    if (!b)
+        return;
+    buffer_monta(b, 0, TIPO_BATIMENTO, NULL, 0);
+    enviar_buffer(sock, b, mac);
+    buffer_solta(b);
+}
+
+// suspeita de falha: -log10 da cauda da normal dos intervalos a partir do ultimo frame ouvido
+double batimento_phi(const Par *p, long long agora_ns)
+{
+    if (config.batimento_ms <= 0 || p->ouvido_ns == 0)
+        return 0;
+    double desvio = sqrt(p->intervalo_var);
+    double minimo = DESVIO_MINIMO * config.batimento_ms * 1e6;
+    if (desvio < minimo)
+        desvio = minimo;
+    double z = (agora_ns - p->ouvido_ns - p->intervalo_ns) / desvio;
+    double cauda = 0.5 * erfc(z / M_SQRT2);
+    return cauda > 0 ? -log10(cauda) : INFINITY;
+}
+
+// o par ficou calado mais do que um par vivo ficaria
+int batimento_falhou(const Par *p)
+{
+    return batimento_phi(p, timestamp_ns()) > config.phi;
+}
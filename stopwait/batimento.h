@@ -0,0 +1,19 @@
+#ifndef BATIMENTO_H
+#define BATIMENTO_H
+
+#include "protocolo.h"
+#include "congestionamento.h"
+
+// deteccao de falha do par: quem fica sem nada para enviar manda um TIPO_BATIMENTO a cada
+// config.batimento_ms, e qualquer frame valido do par conta como sinal de vida
+// o detector (phi accrual) compara o silencio atual com a distribuicao dos intervalos ja
+// vistos: phi = -log10(chance de um par vivo ficar calado tanto tempo)
+// acima de config.phi o par e dado como morto; batimento_ms = 0 desliga tudo
+#define DESVIO_MINIMO 0.5 // desvio minimo dos intervalos, em batimentos (rajadas nao zeram a margem)
+
+void batimento_ouvido(Par *p, long long agora_ns);
+void batimento_pulsa(int sock, const uchar *mac);
+double batimento_phi(const Par *p, long long agora_ns);
+int batimento_falhou(const Par *p);
+
+#endif
@@ -0,0 +1,105 @@
+#include "buffer.h"
+#include <string.h>
+
+static BufferFrame pool[MAX_BUFFERS];
+static int primeiro_livre = -1;
+static int pool_pronto = 0;
+
+// encadeia todos os buffers na lista de livres
+static void pool_inicia(void)
+{
+    for (int i = 0; i < MAX_BUFFERS; i++)
+    {
+        pool[i].refs = 0;
+        pool[i].proximo = i + 1 < MAX_BUFFERS ? i + 1 : -1;
+    }
+    primeiro_livre = 0;
+    pool_pronto = 1;
+}
+
+// retira um buffer do pool com uma referencia, ou NULL se todos estao em uso
+BufferFrame *buffer_aloca(void)
+{
+    if (!pool_pronto)
+        pool_inicia();
+    if (primeiro_livre < 0)
+        return NULL;
+
+    BufferFrame *b = &pool[primeiro_livre];
+    primeiro_livre = b->proximo;
+    b->refs = 1;
+    return b;
+}
+
+void buffer_ref(BufferFrame *b)
+{
+    b->refs++;
+}
+
+// solta uma referencia, o ultimo a soltar devolve o buffer ao pool
+void buffer_solta(BufferFrame *b)
+{
+    if (!b || --b->refs > 0)
+        return;
+    b->proximo = primeiro_livre;
+    primeiro_livre = (int)(b - pool);
+}
+
+// escreve o cabecalho do protocolo e o payload, calculando o checksum na mesma passada
+void buffer_monta(BufferFrame *b, uchar sequencia, uchar tipo, const uchar *dados, uchar tamanho)
+{
+    uchar *cab = buffer_cabecalho(b);
+    uchar *payload = buffer_dados(b);
+    cab[0] = MARCADOR_INICIO;
+    cab[1] = tamanho;
+    cab[2] = sequencia & 0x1F; // 5 bits
+    cab[3] = tipo & 0x0F;      // 4 bits
+
+    uchar chk = cab[1] ^ cab[2] ^ cab[3];
+    if (dados && dados != payload)
+        memcpy(payload, dados, tamanho);
+    for (int i = 0; i < tamanho; i++)
+        chk ^= payload[i];
+    cab[4] = chk;
+}
+
+// mesmo checksum de calcular_checksum, lido direto do buffer
+int buffer_checksum_ok(const BufferFrame *b)
+{
+    const uchar *cab = b->rede + TAMANHO_ETH;
+    uchar chk = cab[1] ^ cab[2] ^ cab[3];
+    for (int i = 0; i < cab[1]; i++)
+        chk ^= cab[5 + i];
+    return chk == cab[4];
+}
+
+// copia o frame para a struct Frame (usado pelas funcoes antigas)
+void buffer_para_frame(const BufferFrame *b, Frame *frame)
+{
+    const uchar *cab = b->rede + TAMANHO_ETH;
+    frame->marcador_inicio = cab[0];
+    frame->tamanho = cab[1];
+    frame->sequencia = cab[2];
+    frame->tipo = cab[3];
+    frame->checksum = cab[4];
+    memcpy(frame->dados, cab + 5, frame->tamanho);
+}
+
+// coloca um Frame num buffer novo, ou NULL se o pool acabou
+BufferFrame *buffer_de_frame(const Frame *frame)
+{
+    BufferFrame *b = buffer_aloca();
+    if (b)
+        serializa_frame(buffer_cabecalho(b), frame);
+    return b;
+}
+
+BufferFrame *buffer_pool(void)
+{
+    return pool;
+}
+
+int buffer_indice(const BufferFrame *b)
+{
+    return (int)(b - pool);
+}
@@ -0,0 +1,53 @@
+#ifndef BUFFER_H
+#define BUFFER_H
+
+#include "protocolo.h"
+
+#define LINHA_CACHE 64
+#define TAMANHO_BUFFER 192 // maior frame na rede (146 bytes), em linhas de cache inteiras
+#if SIMULACAO_ATIVA
+#define MAX_BUFFERS 8192   // todos os nos da simulacao dividem o pool (simulacao.h)
+#else
+#define MAX_BUFFERS 128    // janela de recepcao, FEC e frames em voo cabem com folga
+#endif
+#define ESPACO_RECEPCAO 128 // antes do frame: cabecalho e controle do recvmsg multishot (uring.c)
+
+// frame como ele vai ou vem na rede, a partir do cabecalho Ethernet
+// os acessores abaixo apontam direto para dentro de 'rede', sem copia
+struct BufferFrame {
+    uchar recepcao[ESPACO_RECEPCAO];
+    uchar rede[TAMANHO_BUFFER];
+    long long chegada_ns;    // carimbo de chegada do kernel (carimbo.h), 0 se nao ha
+    long long chegada_hw_ns; // carimbo de chegada da placa, 0 se nao ha
+    int refs;    // referencias vivas, volta ao pool quando chega a zero
+    int proximo; // encadeamento da lista de livres
+} __attribute__((aligned(LINHA_CACHE)));
+
+// pool preallocado, sem malloc
+BufferFrame *buffer_aloca(void);
+void buffer_ref(BufferFrame *b);
+void buffer_solta(BufferFrame *b);
+
+// monta o frame no proprio buffer; se 'dados' ja e buffer_dados(b) nao ha copia
+void buffer_monta(BufferFrame *b, uchar sequencia, uchar tipo, const uchar *dados, uchar tamanho);
+int buffer_checksum_ok(const BufferFrame *b);
+void buffer_para_frame(const BufferFrame *b, Frame *frame);
+BufferFrame *buffer_de_frame(const Frame *frame);
+
+// inicio do pool e posicao de cada buffer nele, para registrar no io_uring
+BufferFrame *buffer_pool(void);
+int buffer_indice(const BufferFrame *b);
+
+// acessores do cabecalho e do payload
+static inline uchar *buffer_mac_destino(BufferFrame *b) { return b->rede; }
+static inline uchar *buffer_mac_origem(BufferFrame *b) { return b->rede + 6; }
+static inline uchar *buffer_cabecalho(BufferFrame *b) { return b->rede + TAMANHO_ETH; }
+static inline uchar buffer_tamanho(const BufferFrame *b) { return b->rede[TAMANHO_ETH + 1]; }
+static inline uchar buffer_sequencia(const BufferFrame *b) { return b->rede[TAMANHO_ETH + 2]; }
+static inline uchar buffer_tipo(const BufferFrame *b) { return b->rede[TAMANHO_ETH + 3]; }
+static inline uchar buffer_checksum(const BufferFrame *b) { return b->rede[TAMANHO_ETH + 4]; }
+static inline uchar *buffer_dados(BufferFrame *b) { return b->rede + TAMANHO_ETH + 5; }
+static inline const uchar *buffer_dados_c(const BufferFrame *b) { return b->rede + TAMANHO_ETH + 5; }
+static inline int buffer_total(const BufferFrame *b) { return TAMANHO_ETH + 5 + buffer_tamanho(b); }
+
+#endif
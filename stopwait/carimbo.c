@@ -0,0 +1,191 @@
+#include "carimbo.h"
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <linux/errqueue.h>
+#include <linux/if_packet.h>
+#include <linux/net_tstamp.h>
+#include <linux/sockios.h>
+
+// o kernel reporta, e a placa gera se tiver relogio proprio
+#define CARIMBO_REPORTE (SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_RX_HARDWARE | \
+                         SOF_TIMESTAMPING_SOFTWARE | SOF_TIMESTAMPING_RAW_HARDWARE)
+// pedido por frame, so para os que esperam resposta
+#define CARIMBO_ENVIO (SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_TX_HARDWARE)
+
+// estado por socket: cada enlace (enlaces.h) tem o seu, com as mesmas sequencias em voo
+// os carimbos de envio de software e de hardware chegam em mensagens separadas
+static struct {
+    uchar ativo;
+    int pendentes; // carimbos de envio pedidos e ainda nao lidos
+    struct {
+        long long software;
+        long long hardware;
+    } enviado[ESPACO_SEQUENCIA];
+} carimbos[MAX_SOCKETS];
+
+static long long ns(const struct timespec *ts)
+{
+    return (long long)ts->tv_sec * 1000000000LL + ts->tv_nsec;
+}
+
+// usa os carimbos em hardware se a placa ja carimba tudo (ex.: um daemon PTP)
+// a configuracao da placa vale para o sistema todo: so e mudada se 'pedir', e nao e desfeita
+static int ativa_hardware(int sock, const char *interface, int pedir)
+{
+    struct hwtstamp_config hw = {0};
+    struct ifreq ifr = {0};
+    strncpy(ifr.ifr_name, interface, IFNAMSIZ - 1);
+    ifr.ifr_data = (void *)&hw;
+    if (ioctl(sock, SIOCGHWTSTAMP, &ifr) == 0 && hw.tx_type == HWTSTAMP_TX_ON &&
+        hw.rx_filter == HWTSTAMP_FILTER_ALL)
+        return 1;
+    if (!pedir)
+        return 0;
+
+    memset(&hw, 0, sizeof(hw));
+    hw.tx_type = HWTSTAMP_TX_ON;
+    hw.rx_filter = HWTSTAMP_FILTER_ALL;
+    return ioctl(sock, SIOCSHWTSTAMP, &ifr) == 0 && hw.rx_filter != HWTSTAMP_FILTER_NONE;
+}
+
+// liga os carimbos no socket; sem suporte o RTT continua medido no espaco do usuario
+// com 'hardware' pede a placa que carimbe, se ela ainda nao carimba
+// retorna 1 se a placa tambem carimba, 0 so em software e -1 se nao ha carimbo
+int carimbo_ativa(int sock, const char *interface, int hardware)
+{
+    if (sock < 0 || sock >= MAX_SOCKETS)
+        return -1;
+    int flags = CARIMBO_REPORTE;
+    if (setsockopt(sock, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) != 0)
+        return -1;
+    carimbos[sock].ativo = 1;
+    return ativa_hardware(sock, interface, hardware);
+}
+
+int carimbo_ativo(int sock)
+{
+    return sock >= 0 && sock < MAX_SOCKETS && carimbos[sock].ativo;
+}
+
+// mensagem de controle SO_TIMESTAMPING que pede o carimbo de envio de um frame
+int carimbo_controle(uchar *controle)
+{
+    memset(controle, 0, CMSG_SPACE(sizeof(int)));
+    struct cmsghdr *c = (struct cmsghdr *)controle;
+    c->cmsg_level = SOL_SOCKET;
+    c->cmsg_type = SO_TIMESTAMPING;
+    c->cmsg_len = CMSG_LEN(sizeof(int));
+    int flags = CARIMBO_ENVIO;
+    memcpy(CMSG_DATA(c), &flags, sizeof(flags));
+    return CMSG_SPACE(sizeof(int));
+}
+
+// o frame com esta sequencia vai sair agora: o carimbo anterior nao vale mais
+void carimbo_envio(int sock, uchar sequencia)
+{
+    if (!carimbo_ativo(sock))
+        return;
+    carimbos[sock].enviado[sequencia % ESPACO_SEQUENCIA].software = 0;
+    carimbos[sock].enviado[sequencia % ESPACO_SEQUENCIA].hardware = 0;
+    carimbos[sock].pendentes++;
+}
+
+// esvazia a fila de erros: cada mensagem traz o frame enviado e o seu carimbo
+// com a fila vazia o poll para de acordar com POLLERR
+void carimbo_colhe(int sock)
+{
+    if (!carimbo_ativo(sock))
+        return;
+
+    uchar frame[TAMANHO_BUFFER];
+    uchar controle[2 * CONTROLE_CARIMBO];
+    for (;;)
+    {
+        struct iovec iov = {frame, sizeof(frame)};
+        struct msghdr m = {0};
+        m.msg_iov = &iov;
+        m.msg_iovlen = 1;
+        m.msg_control = controle;
+        m.msg_controllen = sizeof(controle);
+        int n = recvmsg(sock, &m, MSG_ERRQUEUE | MSG_DONTWAIT);
+        if (n < 0)
+            break;
+        if (carimbos[sock].pendentes > 0)
+            carimbos[sock].pendentes--;
+
+        struct scm_timestamping *ts = NULL;
+        int envio = 0;
+        for (struct cmsghdr *c = CMSG_FIRSTHDR(&m); c; c = CMSG_NXTHDR(&m, c))
+        {
+            if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SO_TIMESTAMPING)
+                ts = (struct scm_timestamping *)CMSG_DATA(c);
+            else if (c->cmsg_level == SOL_PACKET && c->cmsg_type == PACKET_TX_TIMESTAMP)
+            {
+                struct sock_extended_err *erro = (struct sock_extended_err *)CMSG_DATA(c);
+                envio = erro->ee_errno == ENOMSG && erro->ee_origin == SO_EE_ORIGIN_TIMESTAMPING &&
+                        erro->ee_info == SCM_TSTAMP_SND;
+            }
+        }
+
+        // o frame devolvido diz a qual sequencia o carimbo pertence
+        if (!ts || !envio || n < TAMANHO_ETH + 5 ||
+            ntohs(*(unsigned short *)(frame + 12)) != ETHERTYPE_CUSTOM ||
+            frame[TAMANHO_ETH] != MARCADOR_INICIO)
+            continue;
+        uchar seq = frame[TAMANHO_ETH + 2] % ESPACO_SEQUENCIA;
+        if (ns(&ts->ts[0]))
+            carimbos[sock].enviado[seq].software = ns(&ts->ts[0]);
+        if (ns(&ts->ts[2]))
+            carimbos[sock].enviado[seq].hardware = ns(&ts->ts[2]);
+    }
+}
+
+// guarda no buffer os carimbos de chegada vindos com o frame
+void carimbo_recepcao(BufferFrame *b, void *controle, size_t tamanho)
+{
+    b->chegada_ns = 0;
+    b->chegada_hw_ns = 0;
+    if (!tamanho)
+        return;
+
+    struct msghdr m = {0};
+    m.msg_control = controle;
+    m.msg_controllen = tamanho;
+    for (struct cmsghdr *c = CMSG_FIRSTHDR(&m); c; c = CMSG_NXTHDR(&m, c))
+    {
+        if (c->cmsg_level != SOL_SOCKET || c->cmsg_type != SO_TIMESTAMPING)
+            continue;
+        struct scm_timestamping ts;
+        memcpy(&ts, CMSG_DATA(c), sizeof(ts));
+        b->chegada_ns = ns(&ts.ts[0]);
+        b->chegada_hw_ns = ns(&ts.ts[2]);
+    }
+}
+
+// hardware se os dois lados foram carimbados pela placa, senao software
+// 0 se a resposta chegou antes do envio (um ACK atrasado do envio anterior da sequencia)
+static long long diferenca(long long envio, long long chegada)
+{
+    return chegada > envio ? chegada - envio : 0;
+}
+
+long long carimbo_rtt(int sock, uchar sequencia, const BufferFrame *resposta)
+{
+    if (!carimbo_ativo(sock))
+        return -1;
+    // o carimbo de envio costuma estar na fila de erros desde antes da resposta chegar
+    if (carimbos[sock].pendentes > 0)
+        carimbo_colhe(sock);
+
+    sequencia %= ESPACO_SEQUENCIA;
+    if (carimbos[sock].enviado[sequencia].hardware && resposta->chegada_hw_ns)
+        return diferenca(carimbos[sock].enviado[sequencia].hardware, resposta->chegada_hw_ns);
+    if (carimbos[sock].enviado[sequencia].software && resposta->chegada_ns)
+        return diferenca(carimbos[sock].enviado[sequencia].software, resposta->chegada_ns);
+    return -1;
+}
@@ -0,0 +1,27 @@
+#ifndef CARIMBO_H
+#define CARIMBO_H
+
+#include "protocolo.h"
+#include "buffer.h"
+
+// carimbos de tempo do kernel (SO_TIMESTAMPING): recepcao de cada frame e envio dos frames
+// que esperam resposta, em software e em hardware se a placa ja carimba ou se pedido (carimbo_hw)
+// o RTT sai da diferenca entre os carimbos, sem o atraso do escalonador nem do gettimeofday
+#define CONTROLE_CARIMBO 64 // CMSG_SPACE de um pedido de carimbo ou de um scm_timestamping
+
+int carimbo_ativa(int sock, const char *interface, int hardware);
+int carimbo_ativo(int sock);
+
+// envio: controle do sendmsg que pede o carimbo, e o registro da sequencia enviada
+int carimbo_controle(uchar *controle);
+void carimbo_envio(int sock, uchar sequencia);
+void carimbo_colhe(int sock); // le os carimbos de envio da fila de erros do socket
+
+// recepcao: carimbos nas mensagens de controle do recvmsg, guardados no buffer
+void carimbo_recepcao(BufferFrame *b, void *controle, size_t tamanho);
+
+// RTT pelos carimbos entre o envio de 'sequencia' e a chegada da resposta, -1 se faltar algum
+// e 0 se a resposta e anterior ao envio
+long long carimbo_rtt(int sock, uchar sequencia, const BufferFrame *resposta);
+
+#endif
@@ -0,0 +1,387 @@
+#include "config.h"
+#include "protocolo.h"
+#include "congestionamento.h"
+#include "resumo.h"
+#include "mapa.h"
+#include "registro.h"
+#include "giro.h"
+#include "fec.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define OPCOES "c:i:t:r:d:j:H:C:L:m:n:v:b:f:a:P:g:F:G:k:A:u:R:w:T:S"
+
+Config config = {INTERFACE_PADRAO, {{0}}, 0, TIMEOUT_PADRAO, TENTATIVAS_PADRAO, MAX_DADOS, JANELA_MAX, 1,
+                 RESUMO_XXH64, CACHE_PADRAO, CACHE_MB_PADRAO, LARGURA_PADRAO, ALTURA_PADRAO,
+                 TESOUROS_PADRAO, REG_INFO, BATIMENTO_PADRAO, PHI_PADRAO, AQUECE_PADRAO, -1, GIRO_PADRAO_US,
+                 FEC_DESLIGADO, FEC_GRUPO_PADRAO, FEC_PARIDADES_PADRAO, 1, CC_AIMD, 1, 0, GRAVACAO_URING, 0, 0};
+
+// opcoes curtas da linha de comando e a chave equivalente no arquivo
+static const struct {
+    char opcao;
+    const char *chave;
+} opcoes[] = {
+    {'i', "interface"},
+    {'t', "timeout_ms"},
+    {'r', "tentativas"},
+    {'d', "tamanho_dados"},
+    {'j', "janela"},
+    {'H', "resumo"},
+    {'C', "cache"},
+    {'L', "cache_mb"},
+    {'m', "mapa"},
+    {'n', "tesouros"},
+    {'v', "registro"},
+    {'b', "batimento_ms"},
+    {'f', "phi"},
+    {'a', "aquece"},
+    {'P', "cpu"},
+    {'g', "giro_us"},
+    {'F', "fec"},
+    {'G', "fec_grupo"},
+    {'k', "fec_paridades"},
+    {'A', "controle"},
+    {'u', "uring"},
+    {'R', "continua"},
+    {'w', "gravacao"},
+    {'T', "carimbo_hw"},
+};
+
+// valida e grava um valor, retorna -1 se a chave nao existe ou o valor e invalido
+static int config_define(Config *c, const char *chave, const char *valor)
+{
+    if (strcmp(chave, "interface") == 0)
+    {
+        // varias interfaces separadas por virgula ligam o modo multi-enlace
+        char nomes[ENLACES_MAX][IF_NAMESIZE];
+        int n = 0;
+        const char *p = valor;
+        for (;;)
+        {
+            size_t tamanho = strcspn(p, ",");
+            if (tamanho == 0 || tamanho >= IF_NAMESIZE || n == ENLACES_MAX)
+                return -1;
+            memcpy(nomes[n], p, tamanho);
+            nomes[n++][tamanho] = '\0';
+            if (!p[tamanho])
+                break;
+            p += tamanho + 1;
+        }
+        strcpy(c->interface, nomes[0]);
+        for (int i = 1; i < n; i++)
+            strcpy(c->outras[i - 1], nomes[i]);
+        c->n_outras = n - 1;
+        return 0;
+    }
+    if (strcmp(chave, "mapa") == 0)
+    {
+        int largura, altura;
+        char resto;
+        if (sscanf(valor, "%dx%d%c", &largura, &altura, &resto) != 2 || largura < 1 || altura < 1 ||
+            largura > LADO_MAX || altura > LADO_MAX)
+            return -1;
+        c->largura = largura;
+        c->altura = altura;
+        return 0;
+    }
+    if (strcmp(chave, "registro") == 0)
+    {
+        int nivel = registro_nivel_por_nome(valor);
+        if (nivel < 0)
+            return -1;
+        c->registro = nivel;
+        return 0;
+    }
+    if (strcmp(chave, "cache") == 0)
+    {
+        if (!*valor || strlen(valor) >= sizeof(c->cache))
+            return -1;
+        strcpy(c->cache, valor);
+        return 0;
+    }
+    if (strcmp(chave, "resumo") == 0)
+    {
+        for (int a = RESUMO_NENHUM; a <= RESUMO_SHA256; a++)
+        {
+            if (strcmp(valor, resumo_nome(a)) == 0)
+            {
+                c->resumo = a;
+                return 0;
+            }
+        }
+        return -1;
+    }
+    if (strcmp(chave, "fec") == 0)
+    {
+        static const char *const modos[] = {"nenhuma", "xor", "rs"};
+        for (int m = FEC_DESLIGADO; m <= FEC_RS; m++)
+        {
+            if (strcmp(valor, modos[m]) == 0)
+            {
+                c->fec = m;
+                return 0;
+            }
+        }
+        return -1;
+    }
+    if (strcmp(chave, "gravacao") == 0)
+    {
+        static const char *const modos[] = {"uring", "thread", "direta"};
+        for (int m = GRAVACAO_URING; m <= GRAVACAO_DIRETA; m++)
+        {
+            if (strcmp(valor, modos[m]) == 0)
+            {
+                c->gravacao = m;
+                return 0;
+            }
+        }
+        return -1;
+    }
+    if (strcmp(chave, "controle") == 0)
+    {
+        if (strcmp(valor, "aimd") == 0)
+            c->controle = CC_AIMD;
+        else if (strcmp(valor, "atraso") == 0)
+            c->controle = CC_ATRASO;
+        else
+            return -1;
+        return 0;
+    }
+
+    char *fim;
+    long v = strtol(valor, &fim, 10);
+    if (!*valor || *fim)
+        return -1;
+
+    if (strcmp(chave, "timeout_ms") == 0 && v >= 1 && v <= 60000)
+    {
+        c->timeout_ms = v;
+        c->fixos |= CFG_TIMEOUT;
+    }
+    else if (strcmp(chave, "tentativas") == 0 && v >= 1 && v <= 100)
+    {
+        c->tentativas = v;
+        c->fixos |= CFG_TENTATIVAS;
+    }
+    else if (strcmp(chave, "tamanho_dados") == 0 && v >= TAMANHO_MINIMO && v <= MAX_DADOS)
+    {
+        c->tamanho_dados = v;
+        c->fixos |= CFG_TAMANHO;
+    }
+    else if (strcmp(chave, "janela") == 0 && v >= 1 && v <= JANELA_MAX)
+    {
+        c->janela = v;
+        c->fixos |= CFG_JANELA;
+    }
+    else if (strcmp(chave, "sondar") == 0 && (v == 0 || v == 1))
+    {
+        c->sondar = v;
+    }
+    else if (strcmp(chave, "cache_mb") == 0 && v >= 0 && v <= 1048576)
+    {
+        c->cache_mb = v;
+    }
+    else if (strcmp(chave, "tesouros") == 0 && v >= 0 && v <= (long)LADO_MAX * LADO_MAX)
+    {
+        c->tesouros = v;
+    }
+    else if (strcmp(chave, "batimento_ms") == 0 && v >= 0 && v <= 60000)
+    {
+        c->batimento_ms = v;
+    }
+    else if (strcmp(chave, "phi") == 0 && v >= 1 && v <= 100)
+    {
+        c->phi = v;
+    }
+    else if (strcmp(chave, "aquece") == 0 && v >= 0 && v <= AQUECE_MAX)
+    {
+        c->aquece = v;
+    }
+    else if (strcmp(chave, "cpu") == 0 && v >= -1 && v <= CPU_MAX)
+    {
+        c->cpu = v;
+    }
+    else if (strcmp(chave, "giro_us") == 0 && v >= 0 && v <= GIRO_MAX_US)
+    {
+        c->giro_us = v;
+    }
+    else if (strcmp(chave, "fec_grupo") == 0 && v >= 2 && v <= FEC_MAX_DADOS)
+    {
+        c->fec_grupo = v;
+    }
+    else if (strcmp(chave, "fec_paridades") == 0 && v >= 1 && v <= FEC_MAX_PARIDADE)
+    {
+        c->fec_paridades = v;
+    }
+    else if (strcmp(chave, "fec_adaptativo") == 0 && (v == 0 || v == 1))
+    {
+        c->fec_adaptativo = v;
+    }
+    else if (strcmp(chave, "uring") == 0 && (v == 0 || v == 1))
+    {
+        c->uring = v;
+    }
+    else if (strcmp(chave, "continua") == 0 && (v == 0 || v == 1))
+    {
+        c->continua = v;
+    }
+    else if (strcmp(chave, "carimbo_hw") == 0 && (v == 0 || v == 1))
+    {
+        c->carimbo_hw = v;
+    }
+    else
+    {
+        return -1;
+    }
+    return 0;
+}
+
+// le linhas "chave = valor"; '#' comeca um comentario
+// sem o arquivo so e erro se ele foi pedido explicitamente
+int config_arquivo(Config *c, const char *caminho, int obrigatorio)
+{
+    FILE *f = fopen(caminho, "r");
+    if (!f)
+    {
+        if (!obrigatorio)
+            return 0;
+        perror(caminho);
+        return -1;
+    }
+
+    char linha[256];
+    int numero = 0, ret = 0;
+    while (fgets(linha, sizeof(linha), f))
+    {
+        numero++;
+        char *comentario = strchr(linha, '#');
+        if (comentario)
+            *comentario = '\0';
+
+        char chave[64], valor[128], resto;
+        if (sscanf(linha, " %c", &resto) != 1)
+            continue; // linha vazia
+        if (sscanf(linha, " %63[^= \t] = %127s %c", chave, valor, &resto) != 2 ||
+            config_define(c, chave, valor) != 0)
+        {
+            fprintf(stderr, "%s:%d: configuracao invalida\n", caminho, numero);
+            ret = -1;
+        }
+    }
+    fclose(f);
+    return ret;
+}
+
+// arquivo (ARQUIVO_CONFIG ou -c) e depois a linha de comando, que tem a palavra final
+// retorna 0 se tudo valeu, -1 depois de explicar o erro
+int config_le(Config *c, int argc, char **argv)
+{
+    const char *arquivo = ARQUIVO_CONFIG;
+    int obrigatorio = 0;
+    int opt;
+
+    // primeira passada so procura o arquivo
+    opterr = 0;
+    optind = 1;
+    while ((opt = getopt(argc, argv, OPCOES)) != -1)
+    {
+        if (opt == 'c')
+        {
+            arquivo = optarg;
+            obrigatorio = 1;
+        }
+    }
+    if (config_arquivo(c, arquivo, obrigatorio) != 0)
+        return -1;
+
+    opterr = 1;
+    optind = 1;
+    while ((opt = getopt(argc, argv, OPCOES)) != -1)
+    {
+        if (opt == 'c')
+            continue;
+        if (opt == 'S')
+        {
+            c->sondar = 0;
+            continue;
+        }
+
+        const char *chave = NULL;
+        for (size_t i = 0; i < sizeof(opcoes) / sizeof(opcoes[0]); i++)
+            if (opcoes[i].opcao == opt)
+                chave = opcoes[i].chave;
+        if (!chave)
+        {
+            config_uso(argv[0]);
+            return -1;
+        }
+        if (config_define(c, chave, optarg) != 0)
+        {
+            fprintf(stderr, "Valor invalido para -%c: %s\n", opt, optarg);
+            return -1;
+        }
+    }
+    if (optind < argc)
+    {
+        config_uso(argv[0]);
+        return -1;
+    }
+    if ((long long)c->largura * c->altura < c->tesouros)
+    {
+        fprintf(stderr, "%d tesouros nao cabem no mapa %dx%d\n", c->tesouros, c->largura, c->altura);
+        return -1;
+    }
+    return 0;
+}
+
+void config_uso(const char *programa)
+{
+    fprintf(stderr,
+            "uso: %s [-c arquivo] [-i interface] [-t timeout_ms] [-r tentativas]\n"
+            "       [-d tamanho_dados] [-j janela] [-H resumo] [-C cache] [-L cache_mb]\n"
+            "       [-m larguraxaltura] [-n tesouros] [-v registro] [-b batimento_ms] [-f phi]\n"
+            "       [-a aquece] [-P cpu] [-g giro_us] [-F fec] [-G fec_grupo] [-k fec_paridades]\n"
+            "       [-A controle] [-u uring] [-R continua] [-w gravacao]\n"
+            "       [-T carimbo_hw] [-S]\n"
+            "  -i  interface, ou ate %d separadas por virgula: os objetos se espalham por todas\n"
+            "  -H  resumo dos objetos enviados: xxh64 (padrao), sha256 ou nenhum\n"
+            "  -C  diretorio do cache de objetos do cliente (padrao %s)\n"
+            "  -L  limite do cache em MB (padrao %d), 0 desliga\n"
+            "  -m  dimensoes do mapa (padrao %dx%d, lado ate %d), o cliente adota as do servidor\n"
+            "  -n  tesouros enterrados pelo servidor (padrao %d)\n"
+            "  -v  mensagens mostradas: erro, aviso, info (padrao) ou depura\n"
+            "  -b  intervalo dos batimentos do par ocioso (padrao %d ms), 0 desliga a deteccao de falha\n"
+            "  -f  suspeita (phi) a partir da qual o par e dado como morto (padrao %d)\n"
+            "  -a  passos ate um tesouro em que o servidor ja le o objeto (padrao %d, ate %d)\n"
+            "  -P  modo de giro: prende a thread do protocolo nesta CPU e consulta o socket sem dormir\n"
+            "  -g  quanto o modo de giro consulta antes de dormir (padrao %d us)\n"
+            "  -F  correcao de erros nos objetos enviados pelo servidor: nenhuma (padrao), xor ou rs\n"
+            "  -G  frames de dados por grupo da FEC (padrao %d, de 2 a %d)\n"
+            "  -k  frames de paridade por grupo com rs (padrao %d, ate %d)\n"
+            "  -A  controle de congestionamento do servidor: aimd (padrao) ou atraso, pelo RTT\n"
+            "  -u  1 (padrao) usa o io_uring no socket e nos arquivos se o kernel suportar, 0 nao\n"
+            "  -R  1 mostra o objeto no cliente enquanto ele chega, 0 (padrao) so depois de conferido\n"
+            "  -w  como o cliente grava os objetos: uring (padrao, pela thread sem io_uring),\n"
+            "      thread ou direta\n"
+            "  -T  1 liga os carimbos de tempo na placa de rede, para todo o sistema e sem desfazer;\n"
+            "      0 (padrao) so os usa se ela ja carimba, senao fica com os do kernel\n"
+            "  -S  nao sonda o enlace ao iniciar\n"
+            "o arquivo (padrao %s) aceita linhas 'chave = valor' com as chaves\n"
+            "interface, timeout_ms, tentativas, tamanho_dados, janela, resumo, cache,\n"
+            "cache_mb, mapa, tesouros, registro, batimento_ms, phi, aquece, cpu, giro_us, fec,\n"
+            "fec_grupo, fec_paridades, fec_adaptativo (0 fixa a redundancia), controle,\n"
+            "uring, continua, gravacao, carimbo_hw e sondar; o que nao for definido vem da\n"
+            "sondagem do enlace\n",
+            programa, ENLACES_MAX, CACHE_PADRAO, CACHE_MB_PADRAO, LARGURA_PADRAO, ALTURA_PADRAO, LADO_MAX,
+            TESOUROS_PADRAO, BATIMENTO_PADRAO, PHI_PADRAO, AQUECE_PADRAO, AQUECE_MAX,
+            GIRO_PADRAO_US, FEC_GRUPO_PADRAO, FEC_MAX_DADOS, FEC_PARIDADES_PADRAO, FEC_MAX_PARIDADE,
+            ARQUIVO_CONFIG);
+}
+
+void config_mostra(const Config *c)
+{
+    registra(REG_INFO, "Sessao: payload %d bytes, janela %d, timeout %d ms, %d tentativas",
+             c->tamanho_dados, c->janela, c->timeout_ms, c->tentativas);
+}
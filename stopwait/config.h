@@ -0,0 +1,77 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <net/if.h>
+
+#define ARQUIVO_CONFIG "stopwait.conf" // lido do diretorio atual, se existir
+#define INTERFACE_PADRAO "enp0s31f6"
+#define TIMEOUT_PADRAO 2000  // ms
+#define TENTATIVAS_PADRAO 5
+#define TIMEOUT_MINIMO 50    // ms, abaixo disso o escalonador ja gera retransmissao a toa
+#define FOLGA_TIMEOUT 4      // timeout = FOLGA_TIMEOUT * RTO medido, cobre o processamento do par
+#define TAMANHO_MINIMO 16    // payload minimo dos frames de dados (cabe o cabecalho da FEC)
+#define CACHE_PADRAO "cache" // diretorio do cache de objetos do cliente
+#define CACHE_MB_PADRAO 64   // limite do cache, 0 desliga
+#define BATIMENTO_PADRAO 500 // ms entre batimentos do par ocioso (batimento.h), 0 desliga
+#define PHI_PADRAO 8         // suspeita acima da qual o par e dado como morto
+#define AQUECE_PADRAO 3      // passos ate um tesouro para o servidor ler o objeto antes, 0 desliga
+#define AQUECE_MAX 64
+#define CPU_MAX 1023         // maior CPU aceita para o modo de giro (giro.h)
+#define ENLACES_MAX 4        // interfaces em -i, separadas por virgula (enlaces.h)
+#define FEC_GRUPO_PADRAO 8   // frames de dados por grupo de FEC (fec.h)
+#define FEC_PARIDADES_PADRAO 2 // frames de paridade por grupo com Reed-Solomon
+
+// como o cliente grava os objetos recebidos
+#define GRAVACAO_URING 0  // pelo io_uring se ele estiver ativo, senao pela thread
+#define GRAVACAO_THREAD 1 // pela thread de gravacao (gravador.h), mesmo com io_uring
+#define GRAVACAO_DIRETA 2 // na propria recepcao
+
+// campos definidos pelo usuario, que a sondagem do enlace nao muda
+#define CFG_TIMEOUT 1
+#define CFG_TENTATIVAS 2
+#define CFG_TAMANHO 4
+#define CFG_JANELA 8
+
+// parametros da sessao: padrao, depois o arquivo, depois a linha de comando,
+// e por fim a sondagem do enlace para o que o usuario nao fixou
+typedef struct {
+    char interface[IF_NAMESIZE]; // primeira de -i: controle e dados
+    char outras[ENLACES_MAX - 1][IF_NAMESIZE]; // as seguintes, so para os dados dos objetos
+    int n_outras;
+    int timeout_ms;    // espera pelo ACK antes de retransmitir
+    int tentativas;    // envios de um frame antes de desistir
+    int tamanho_dados; // payload dos frames de dados, ate MAX_DADOS
+    int janela;        // frames em voo, ate JANELA_MAX
+    int sondar;        // o cliente sonda o enlace ao iniciar
+    int resumo;        // RESUMO_* dos objetos enviados (resumo.h)
+    char cache[128];   // diretorio do cache de objetos do cliente
+    int cache_mb;      // limite do cache em MB, 0 desliga
+    int largura;       // dimensoes do mapa; o cliente adota as do servidor na sondagem
+    int altura;
+    int tesouros;      // enterrados pelo servidor
+    int registro;      // REG_* mais detalhado que aparece (registro.h)
+    int batimento_ms;  // intervalo dos batimentos, 0 desliga a deteccao de falha
+    int phi;           // limiar do detector de falha
+    int aquece;        // distancia de Manhattan em que o servidor ja le o objeto do tesouro
+    int cpu;           // CPU da thread do protocolo no modo de giro, -1 desliga
+    int giro_us;       // quanto o modo de giro consulta o socket antes de dormir
+    int fec;           // FEC_* das transferencias do servidor (fec.h)
+    int fec_grupo;     // frames de dados por grupo
+    int fec_paridades; // frames de paridade por grupo (RS)
+    int fec_adaptativo; // ajusta a redundancia pela perda medida
+    int controle;      // CC_* do controle de congestionamento por cliente (congestionamento.h)
+    int uring;         // socket e arquivos pelo io_uring, se o kernel suportar
+    int continua;      // o visualizador do cliente recebe os dados enquanto o objeto chega
+    int gravacao;      // GRAVACAO_* dos objetos recebidos pelo cliente
+    int carimbo_hw;    // liga os carimbos na placa (carimbo.h), uma mudanca para o sistema todo
+    unsigned fixos;    // CFG_* definidos pelo usuario
+} Config;
+
+extern Config config;
+
+int config_le(Config *c, int argc, char **argv);
+int config_arquivo(Config *c, const char *caminho, int obrigatorio);
+void config_uso(const char *programa);
+void config_mostra(const Config *c);
+
+#endif
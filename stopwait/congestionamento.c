@@ -0,0 +1,204 @@
+#include "congestionamento.h"
+#include "config.h"
+#include "registro.h"
+#include "simulacao.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define VEGAS_ALFA 1.0 // frames na fila abaixo disso: aumenta
+#define VEGAS_BETA 3.0 // frames na fila acima disso: diminui
+#define GANHO_RITMO 1.25 // envia um pouco acima da taxa estimada para o RTT poder cair
+#define RECUO_MAX 6      // o timeout dobra ate 64x o medido (ainda limitado pelo da sessao)
+
+static Par pares[MAX_PARES];
+static int variante_padrao = CC_AIMD;
+static int janela_maxima = JANELA_MAX;
+
+// escolhe a variante usada pelos pares criados daqui em diante e o limite da janela da sessao
+void cc_configura(int variante, int janela)
+{
+    variante_padrao = variante;
+    janela_maxima = janela < 1 ? 1 : (janela > JANELA_MAX ? JANELA_MAX : janela);
+}
+
+// procura o estado do par, criando (ou reaproveitando o mais antigo) se nao existe
+Par *par_busca(const uchar *mac)
+{
+    Par *livre = NULL;
+    for (int i = 0; i < MAX_PARES; i++)
+    {
+        if (pares[i].em_uso && memcmp(pares[i].mac, mac, 6) == 0)
+        {
+            pares[i].usado_ns = timestamp_ns();
+            return &pares[i];
+        }
+        if (!livre || !pares[i].em_uso || (livre->em_uso && pares[i].usado_ns < livre->usado_ns))
+            livre = &pares[i];
+    }
+
+    memset(livre, 0, sizeof(*livre));
+    livre->em_uso = 1;
+    memcpy(livre->mac, mac, 6);
+    livre->variante = variante_padrao;
+    livre->usado_ns = timestamp_ns();
+    livre->janela = 1;
+    livre->limiar = janela_maxima;
+    livre->cabecalho_sock = -1;
+    return livre;
+}
+
+// sessao encerrada: a entrada volta a ficar livre, um par que voltar comeca do zero
+void par_esquece(Par *p)
+{
+    memset(p, 0, sizeof(*p));
+    p->cabecalho_sock = -1;
+}
+
+// frames que podem estar em voo agora
+int cc_janela(const Par *p)
+{
+    int janela = (int)p->janela;
+    if (janela < 1)
+        return 1;
+    return janela > janela_maxima ? janela_maxima : janela;
+}
+
+// recalcula a taxa de envio a partir da janela e do RTT
+static void atualiza_taxa(Par *p)
+{
+    if (p->rtt_suave_ns <= 0)
+        return;
+    p->taxa = GANHO_RITMO * p->janela * TAMANHO_FRAME_ETH * 1e9 / p->rtt_suave_ns;
+}
+
+// ACK de um frame que nao foi retransmitido, com o RTT medido
+void cc_ack(Par *p, long long rtt_ns)
+{
+    if (rtt_ns <= 0)
+        rtt_ns = 1;
+    if (p->rtt_min_ns == 0 || rtt_ns < p->rtt_min_ns)
+        p->rtt_min_ns = rtt_ns;
+    if (rtt_ns > p->rtt_max_ns)
+        p->rtt_max_ns = rtt_ns;
+    if (p->rtt_suave_ns == 0)
+    {
+        p->rtt_suave_ns = rtt_ns;
+        p->rtt_var_ns = rtt_ns / 2;
+    }
+    else
+    {
+        long long desvio = p->rtt_suave_ns > rtt_ns ? p->rtt_suave_ns - rtt_ns : rtt_ns - p->rtt_suave_ns;
+        p->rtt_var_ns = (3 * p->rtt_var_ns + desvio) / 4;
+        p->rtt_suave_ns = (7 * p->rtt_suave_ns + rtt_ns) / 8;
+    }
+    p->amostras++;
+    p->recuo = 0;
+
+    if (p->janela < p->limiar)
+    {
+        // slow start: dobra a cada RTT
+        p->janela += 1;
+    }
+    else if (p->variante == CC_ATRASO)
+    {
+        // frames parados na fila = janela * (1 - rtt_min / rtt)
+        double fila = p->janela * (1.0 - (double)p->rtt_min_ns / p->rtt_suave_ns);
+        if (fila < VEGAS_ALFA)
+            p->janela += 1.0 / p->janela;
+        else if (fila > VEGAS_BETA)
+            p->janela -= 1.0 / p->janela;
+    }
+    else
+    {
+        // aumento aditivo: um frame por RTT
+        p->janela += 1.0 / p->janela;
+    }
+
+    if (p->janela > janela_maxima)
+        p->janela = janela_maxima;
+    if (p->janela < 1)
+        p->janela = 1;
+    atualiza_taxa(p);
+}
+
+// timeout: reducao multiplicativa
+void cc_perda(Par *p)
+{
+    p->limiar = p->janela / 2;
+    if (p->limiar < 2)
+        p->limiar = 2;
+    p->janela = p->janela / 2 < 1 ? 1 : p->janela / 2;
+    if (p->recuo < RECUO_MAX)
+        p->recuo++;
+    atualiza_taxa(p);
+}
+
+// espera pelo ACK: RTO medido com folga, dobrado a cada timeout seguido,
+// entre TIMEOUT_MINIMO e o timeout da sessao (que vale sozinho antes da primeira amostra)
+int cc_timeout_ms(const Par *p, int timeout_ms)
+{
+    if (p->amostras == 0)
+        return timeout_ms;
+    long long rto_ns = FOLGA_TIMEOUT * (p->rtt_suave_ns + 4 * p->rtt_var_ns);
+    long long espera = ((rto_ns + 999999) / 1000000) << p->recuo;
+    if (espera < TIMEOUT_MINIMO)
+        espera = TIMEOUT_MINIMO;
+    return espera < timeout_ms ? (int)espera : timeout_ms;
+}
+
+void cc_mostra(const Par *p)
+{
+    if (p->amostras == 0)
+        return;
+    registra(REG_INFO, "RTT: min %.1f us, suavizado %.1f us, desvio %.1f us, max %.1f us (%d amostras)",
+             p->rtt_min_ns / 1e3, p->rtt_suave_ns / 1e3, p->rtt_var_ns / 1e3, p->rtt_max_ns / 1e3,
+             p->amostras);
+}
+
+// repoe as fichas pelo tempo passado desde a ultima reposicao
+static void repoe_fichas(Par *p)
+{
+    long long agora = timestamp_ns();
+    double capacidade = (double)RAJADA_FRAMES * TAMANHO_FRAME_ETH;
+    if (p->fichas_ns == 0)
+        p->fichas = capacidade;
+    else
+        p->fichas += (agora - p->fichas_ns) * p->taxa / 1e9;
+    if (p->fichas > capacidade)
+        p->fichas = capacidade;
+    p->fichas_ns = agora;
+}
+
+// quanto ritmo_espera dormiria antes de enviar 'bytes', sem gastar fichas
+long long ritmo_atraso_ns(Par *p, int bytes)
+{
+    if (p->taxa <= 0)
+        return 0;
+    repoe_fichas(p);
+    return p->fichas < bytes ? (long long)((bytes - p->fichas) * 1e9 / p->taxa) : 0;
+}
+
+// balde de fichas: espera ate poder enviar 'bytes' sem passar da taxa do par
+void ritmo_espera(Par *p, int bytes)
+{
+    if (p->taxa <= 0)
+        return; // ainda sem RTT medido, nao ha taxa para seguir
+
+    repoe_fichas(p);
+    if (p->fichas < bytes)
+    {
+        long long espera_ns = (long long)((bytes - p->fichas) * 1e9 / p->taxa);
+        if (sim_rodando)
+        {
+            sim_dorme(espera_ns);
+        }
+        else
+        {
+            struct timespec ts = {espera_ns / 1000000000LL, espera_ns % 1000000000LL};
+            clock_nanosleep(CLOCK_MONOTONIC, 0, &ts, NULL);
+        }
+        repoe_fichas(p);
+    }
+    p->fichas -= bytes;
+}
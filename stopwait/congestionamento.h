@@ -0,0 +1,60 @@
+#ifndef CONGESTIONAMENTO_H
+#define CONGESTIONAMENTO_H
+
+#include "protocolo.h"
+
+// variantes do controle de congestionamento
+#define CC_AIMD 0   // aumento aditivo, reducao multiplicativa na perda
+#define CC_ATRASO 1 // estilo Vegas: ajusta pela fila estimada a partir do RTT
+
+#if SIMULACAO_ATIVA
+#define MAX_PARES 512        // na simulacao cada no e um par (simulacao.h)
+#else
+#define MAX_PARES 16         // pares acompanhados ao mesmo tempo
+#endif
+#define JANELA_MAX 15        // frames em voo, cabe na janela de recepcao
+#define TAMANHO_FRAME_ETH (TAMANHO_ETH + 5 + MAX_DADOS) // maior frame na rede
+#define RAJADA_FRAMES 4      // capacidade do balde de fichas, em frames
+
+// estado de congestionamento e ritmo de envio para um par (MAC de destino)
+typedef struct {
+    int em_uso;
+    uchar mac[6];
+    int variante;
+    long long usado_ns;    // ultimo uso, para reaproveitar a entrada mais antiga
+
+    double janela;         // frames que podem estar em voo
+    double limiar;         // fim do slow start
+    long long rtt_min_ns;  // menor RTT visto, base da variante por atraso
+    long long rtt_suave_ns;
+    long long rtt_var_ns;  // variacao do RTT, para o timeout (RFC 6298)
+    long long rtt_max_ns;
+    int amostras;
+    int recuo;             // timeouts seguidos, dobram o timeout do par
+
+    double fichas;         // bytes que podem ser enviados agora
+    double taxa;           // bytes por segundo, 0 enquanto nao ha RTT medido
+    long long fichas_ns;   // instante da ultima reposicao de fichas
+
+    uchar cabecalho[TAMANHO_ETH]; // cabecalho Ethernet pronto para este destino
+    int cabecalho_sock;           // socket (interface) usado para montar o cabecalho, -1 se nenhum
+
+    // detector de falha do par (batimento.h)
+    long long enviado_ns;  // ultimo frame para o par, o batimento so vai se ele ficou sem nada
+    long long ouvido_ns;   // ultimo frame valido do par, 0 se nunca
+    double intervalo_ns;   // media dos intervalos entre os frames do par
+    double intervalo_var;  // variancia desses intervalos
+} Par;
+
+void cc_configura(int variante, int janela);
+Par *par_busca(const uchar *mac);
+void par_esquece(Par *p);
+int cc_janela(const Par *p);
+void cc_ack(Par *p, long long rtt_ns);
+void cc_perda(Par *p);
+int cc_timeout_ms(const Par *p, int timeout_ms);
+void cc_mostra(const Par *p);
+long long ritmo_atraso_ns(Par *p, int bytes);
+void ritmo_espera(Par *p, int bytes);
+
+#endif
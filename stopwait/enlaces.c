@@ -0,0 +1,403 @@
+#include "enlaces.h"
+#include "uring.h"
+#include "registro.h"
+#include "batimento.h"
+#include <string.h>
+#include <limits.h>
+#include <poll.h>
+
+#define RECUO_ESCALA 16 // maior deslocamento do custo de um enlace com timeouts seguidos
+#define COLHE_MAX 64    // frames tratados por enlace em cada enlaces_colhe
+
+Enlace enlaces[ENLACES_MAX];
+int n_enlaces = 0;
+
+static const uchar difusao[6] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+
+// o primeiro enlace e 'sock', ja aberto em config.interface; os outros abrem aqui
+// retorna quantos enlaces ficaram
+int enlaces_abre(int sock)
+{
+    enlaces[0] = (Enlace){.sock = sock, .nome = config.interface};
+    n_enlaces = 1;
+    for (int i = 0; i < config.n_outras; i++)
+    {
+        enlaces[n_enlaces] = (Enlace){.sock = cria_raw_socket(config.outras[i]), .nome = config.outras[i]};
+        n_enlaces++;
+    }
+    return n_enlaces;
+}
+
+// MAC do par no enlace: no primeiro e o da sessao, nos outros o aprendido
+static const uchar *mac_do(const Enlace *e, const uchar *principal)
+{
+    return e == &enlaces[0] ? principal : e->mac_par;
+}
+
+// frame valido num enlace a mais: quem enviou e o par do outro lado dele
+// num enlace caido e sinal de que voltou, o teste vai ja no proximo grupo
+static void aprende(Enlace *e, BufferFrame *b)
+{
+    if (e->caido)
+        e->caiu_ns = 0;
+    if (e == &enlaces[0] || (e->conhece_par && memcmp(e->mac_par, buffer_mac_origem(b), 6) == 0))
+        return;
+    memcpy(e->mac_par, buffer_mac_origem(b), 6);
+    e->conhece_par = 1;
+    registra(REG_INFO, "Enlace %s: par %02x:%02x:%02x:%02x:%02x:%02x", e->nome, e->mac_par[0], e->mac_par[1],
+             e->mac_par[2], e->mac_par[3], e->mac_par[4], e->mac_par[5]);
+}
+
+// ha algo para ler no enlace, sem dormir
+static int pronto(const Enlace *e)
+{
+    if (uring_ativo(e->sock))
+        return uring_consulta(e->sock);
+    struct pollfd pfd = {.fd = e->sock, .events = POLLIN};
+    return poll(&pfd, 1, 0) > 0;
+}
+
+// dorme ate algum enlace ter o que ler, ou o prazo acabar
+static void espera(long long timeout_ms)
+{
+    struct pollfd pfd[ENLACES_MAX];
+    nfds_t n = n_enlaces > 0 && n_enlaces <= ENLACES_MAX ? (nfds_t)n_enlaces : 0;
+    for (nfds_t i = 0; i < n; i++)
+    {
+        pfd[i].fd = uring_ativo(enlaces[i].sock) ? uring_fd() : enlaces[i].sock;
+        pfd[i].events = POLLIN;
+    }
+    poll(pfd, n, (int)timeout_ms);
+}
+
+// cliente: um batimento em cada enlace a mais, para o servidor aprender o nosso MAC nele
+// vai em difusao ate o servidor usar o enlace; repetido a cada batimento, cobre as perdas
+void enlaces_apresenta(void)
+{
+    for (int i = 1; i < n_enlaces; i++)
+    {
+        BufferFrame *b = buffer_aloca();
+        if (!b)
+            return;
+        buffer_monta(b, 0, TIPO_BATIMENTO, NULL, 0);
+        enviar_buffer(enlaces[i].sock, b, enlaces[i].conhece_par ? enlaces[i].mac_par : difusao);
+        buffer_solta(b);
+    }
+}
+
+// fora de uma transferencia: le as apresentacoes do par e os repetidos atrasados dos enlaces
+// a mais; os repetidos sao confirmados de novo e descartados
+void enlaces_colhe(void)
+{
+    for (int i = 1; i < n_enlaces; i++)
+    {
+        for (int k = 0; k < COLHE_MAX && pronto(&enlaces[i]); k++)
+        {
+            BufferFrame *b;
+            if (tentar_receber_buffer_com_ack(enlaces[i].sock, &b, NULL) != 0)
+                continue;
+            aprende(&enlaces[i], b);
+            buffer_solta(b);
+        }
+    }
+}
+
+// recebe o proximo frame valido de qualquer enlace, confirmado pelo enlace em que chegou
+// frames dos enlaces a mais tambem contam como sinal de vida do par da sessao
+// retorna o indice do enlace, ou -1 se o prazo acabou
+int enlaces_recebe(BufferFrame **saida, const uchar *principal, int timeout_ms)
+{
+    static int primeiro; // cada volta comeca num enlace diferente, nenhum fica para tras
+    long long fim = timestamp_ms() + timeout_ms;
+    long long restante;
+    do
+    {
+        for (int k = 0; k < n_enlaces; k++)
+        {
+            int i = (primeiro + k) % n_enlaces;
+            Enlace *e = &enlaces[i];
+            if (!pronto(e) || tentar_receber_buffer_com_ack(e->sock, saida, NULL) != 0)
+                continue;
+            primeiro = i + 1;
+            if (i > 0)
+            {
+                aprende(e, *saida);
+                batimento_ouvido(par_busca(principal), timestamp_ns());
+            }
+            return i;
+        }
+        restante = fim - timestamp_ms();
+        if (restante > 0)
+            espera(restante);
+    } while (restante > 0);
+    *saida = NULL;
+    return -1;
+}
+
+// timeout ou erro de envio no enlace; depois de config.tentativas seguidos ele sai da escala
+static void falha(Enlace *e, Par *par)
+{
+    cc_perda(par);
+    if (++e->falhas < config.tentativas || e->caido)
+        return;
+    e->caido = 1;
+    e->caiu_ns = timestamp_ns();
+    registra(REG_AVISO, "Enlace %s sem resposta, os dados seguem pelos outros", e->nome);
+}
+
+// escolhe o enlace que deve entregar mais um frame primeiro: o atraso do ritmo dele, mais o
+// RTT sem fila, mais os frames que ja tem em voo escoados pela vazao medida nele
+// cada timeout seguido dobra o custo, e o enlace so leva um frame por vez ate ser confirmado
+// um enlace caido leva um frame de teste a cada ENLACE_TESTE_MS
+// medidas velhas deixam de valer: um enlace que ficou sem frames por uma amostra ruim volta a ser medido
+// retorna NULL se nenhum enlace pode levar mais um frame agora
+static Enlace *escolhe(Par *pares[], int bytes, long long agora)
+{
+    // enlace ainda sem RTT entra com o menor dos outros, para ser medido logo
+    long long rtt_padrao = LLONG_MAX;
+    for (int i = 0; i < n_enlaces; i++)
+        if (pares[i] && enlaces[i].rtt_min_ns > 0 && enlaces[i].rtt_min_ns < rtt_padrao)
+            rtt_padrao = enlaces[i].rtt_min_ns;
+    if (rtt_padrao == LLONG_MAX)
+        rtt_padrao = 1;
+
+    Enlace *melhor = NULL;
+    long long menor = LLONG_MAX;
+    for (int i = 0; i < n_enlaces; i++)
+    {
+        Enlace *e = &enlaces[i];
+        Par *par = pares[i];
+        if (!par)
+            continue;
+        if (e->ack_ns && !e->em_voo && agora - e->ack_ns > MEDIDA_VALIDADE_MS * 1000000LL)
+        {
+            e->rtt_min_ns = 0;
+            e->servico_ns = 0;
+            e->ack_ns = 0;
+            e->ocupado = 0;
+        }
+        if (e->caido)
+        {
+            if (e->em_voo || agora - e->caiu_ns < ENLACE_TESTE_MS * 1000000LL)
+                continue;
+            e->caiu_ns = agora;
+            return e;
+        }
+        if (e->em_voo >= (e->falhas ? 1 : cc_janela(par)))
+            continue;
+        long long rtt = e->rtt_min_ns > 0 ? e->rtt_min_ns : rtt_padrao;
+        long long custo = ritmo_atraso_ns(par, bytes) + rtt + e->em_voo * e->servico_ns;
+        custo <<= e->falhas < RECUO_ESCALA ? e->falhas : RECUO_ESCALA;
+        if (custo < menor)
+        {
+            menor = custo;
+            melhor = e;
+        }
+    }
+    return melhor;
+}
+
+// envia um grupo de frames espalhado pelos enlaces e espera o ACK de cada um
+// frame sem ACK no prazo do enlace em que foi volta para a escala e pode ir por outro
+// retorna quantos frames foram reenviados, ou -1 se nenhum enlace responde mais
+int enlaces_envia_grupo(BufferFrame *frames[], int n, const uchar *principal, int timeout_ms)
+{
+    unsigned int pendentes = (1u << n) - 1; // bit i ligado = frame i sem ACK
+    unsigned int enviados = 0;              // sairam por algum enlace ao menos uma vez
+    unsigned int em_voo = 0;                // enviados e aguardando ACK
+    unsigned int reenviados = 0;            // nao servem para medir RTT
+    long long enviado_ns[ENLACES_GRUPO] = {0};
+    long long prazo_ns[ENLACES_GRUPO] = {0};
+    Enlace *por[ENLACES_GRUPO] = {0};
+    Par *pares[ENLACES_MAX];
+    int perdidos = 0;
+
+    for (int i = 0; i < n_enlaces; i++)
+        enlaces[i].em_voo = 0;
+
+    while (pendentes)
+    {
+        // estado de congestionamento de cada enlace, NULL se o par nele ainda e desconhecido
+        for (int i = 0; i < n_enlaces; i++)
+            pares[i] = i == 0 || enlaces[i].conhece_par ? par_busca(mac_do(&enlaces[i], principal)) : NULL;
+
+        // distribui os frames sem ACK e fora de voo, num unico lote
+        uring_lote(1);
+        for (int i = 0; i < n; i++)
+        {
+            unsigned int bit = 1u << i;
+            if (!(pendentes & bit) || (em_voo & bit))
+                continue;
+            Enlace *e = escolhe(pares, buffer_total(frames[i]), timestamp_ns());
+            if (!e)
+                break;
+            Par *par = pares[e - enlaces];
+            if (enviados & bit)
+            {
+                reenviados |= bit;
+                perdidos++;
+            }
+            // se o ritmo vai dormir, o lote ja montado segue antes
+            if (ritmo_atraso_ns(par, buffer_total(frames[i])) > 0)
+                uring_lote(0);
+            ritmo_espera(par, buffer_total(frames[i]));
+            uring_lote(1);
+            enviado_ns[i] = timestamp_ns();
+            if (enviar_buffer(e->sock, frames[i], mac_do(e, principal)) != 0)
+            {
+                falha(e, par); // interface fora do ar
+                continue;
+            }
+            enviados |= bit;
+            prazo_ns[i] = enviado_ns[i] + cc_timeout_ms(par, timeout_ms) * 1000000LL;
+            por[i] = e;
+            e->em_voo++;
+            em_voo |= bit;
+        }
+        uring_lote(0);
+
+        // so fica sem nada em voo com todos os enlaces caidos e sem teste a fazer
+        if (!em_voo)
+        {
+            registra(REG_AVISO, "Nenhum enlace responde, desistindo do grupo");
+            return -1;
+        }
+
+        // espera um ACK em qualquer enlace, ate o prazo mais proximo dos frames em voo
+        long long prazo = LLONG_MAX;
+        for (int i = 0; i < n; i++)
+            if ((em_voo & (1u << i)) && prazo_ns[i] < prazo)
+                prazo = prazo_ns[i];
+        int progresso = 0;
+        long long agora;
+        while (!progresso && (agora = timestamp_ns()) < prazo)
+        {
+            BufferFrame *resposta = NULL;
+            Enlace *e = NULL;
+            for (int k = 0; k < n_enlaces && !e; k++)
+            {
+                if (!pronto(&enlaces[k]))
+                    continue;
+                if (receber_buffer(enlaces[k].sock, &resposta, NULL) == 0)
+                {
+                    e = &enlaces[k];
+                    break;
+                }
+                buffer_solta(resposta);
+                resposta = NULL;
+            }
+            if (!e)
+            {
+                espera((prazo - agora + 999999) / 1000000);
+                continue;
+            }
+            aprende(e, resposta);
+            if (e != &enlaces[0] || memcmp(buffer_mac_origem(resposta), principal, 6) == 0)
+                batimento_ouvido(par_busca(principal), timestamp_ns());
+
+            uchar tipo = buffer_tipo(resposta);
+            for (int i = 0; i < n && (tipo == 0 || tipo == 1); i++)
+            {
+                unsigned int bit = 1u << i;
+                // resposta com a sequencia de um frame que nunca saiu e de outro grupo
+                if (!(pendentes & bit) || !(enviados & bit) ||
+                    buffer_sequencia(frames[i]) != buffer_sequencia(resposta))
+                    continue;
+                // ACK atrasado de um frame ja devolvido a escala tambem vale
+                Enlace *de = por[i];
+                if (em_voo & bit)
+                {
+                    em_voo &= ~bit;
+                    de->em_voo--;
+                }
+                progresso = 1;
+                if (tipo == 1)
+                    break; // NACK: reenvia na proxima volta, sem contar como congestionamento
+                pendentes &= ~bit;
+                long long agora_ack = timestamp_ns();
+                if (de->ocupado)
+                {
+                    long long intervalo = agora_ack - de->ack_ns;
+                    de->servico_ns = de->servico_ns ? (7 * de->servico_ns + intervalo) / 8 : intervalo;
+                }
+                de->ack_ns = agora_ack;
+                de->ocupado = de->em_voo > 0;
+                de->frames++;
+                de->bytes += buffer_tamanho(frames[i]);
+                de->falhas = 0;
+                if (de->caido)
+                {
+                    de->caido = 0;
+                    registra(REG_AVISO, "Enlace %s voltou a responder", de->nome);
+                }
+                if (!(reenviados & bit))
+                {
+                    long long local = agora_ack - enviado_ns[i];
+                    if (de->rtt_min_ns == 0 || local < de->rtt_min_ns)
+                        de->rtt_min_ns = local;
+                    long long rtt = mede_rtt(de->sock, buffer_sequencia(frames[i]), resposta, enviado_ns[i]);
+                    if (rtt >= 0)
+                        cc_ack(pares[de - enlaces], rtt);
+                }
+                break;
+            }
+            buffer_solta(resposta);
+        }
+        if (progresso)
+            continue;
+
+        // prazo vencido: os frames atrasados voltam para a escala, e cada enlace deles conta uma falha
+        unsigned int falharam = 0;
+        for (int i = 0; i < n; i++)
+        {
+            unsigned int bit = 1u << i;
+            if ((em_voo & bit) && prazo_ns[i] <= agora)
+            {
+                em_voo &= ~bit;
+                por[i]->em_voo--;
+                falharam |= 1u << (por[i] - enlaces);
+            }
+        }
+        for (int i = 0; i < n_enlaces; i++)
+            if (falharam & (1u << i))
+                falha(&enlaces[i], pares[i]);
+        if (batimento_falhou(par_busca(principal)))
+        {
+            registra(REG_AVISO, "Par sem sinal de vida, desistindo do grupo");
+            return -1;
+        }
+    }
+    return perdidos;
+}
+
+// sessao encerrada: os pares dos enlaces a mais sao aprendidos de novo
+void enlaces_esquece(void)
+{
+    for (int i = 0; i < n_enlaces; i++)
+    {
+        enlaces[i].conhece_par = 0;
+        enlaces[i].caido = 0;
+        enlaces[i].falhas = 0;
+    }
+}
+
+// quanto cada enlace levou desde a ultima chamada, e zera as contagens
+void enlaces_mostra(long long duracao_ns)
+{
+    long long total = 0;
+    for (int i = 0; i < n_enlaces; i++)
+        total += enlaces[i].frames;
+    for (int i = 0; i < n_enlaces; i++)
+    {
+        Enlace *e = &enlaces[i];
+        if (i == 0 || e->conhece_par)
+        {
+            registra(REG_INFO, "Enlace %s: %lld frames (%.0f%%), %.1f KB/s, RTT min %.1f us, %.1f us por frame%s",
+                     e->nome, e->frames, total ? 100.0 * e->frames / total : 0.0,
+                     duracao_ns > 0 ? e->bytes * 1e6 / duracao_ns : 0.0, e->rtt_min_ns / 1e3, e->servico_ns / 1e3,
+                     e->caido ? ", caido" : "");
+        }
+        e->frames = 0;
+        e->bytes = 0;
+    }
+}
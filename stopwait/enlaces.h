@@ -0,0 +1,53 @@
+#ifndef ENLACES_H
+#define ENLACES_H
+
+#include <net/if.h>
+#include "protocolo.h"
+#include "buffer.h"
+#include "config.h"
+#include "congestionamento.h"
+
+// modo multi-enlace: -i com varias interfaces abre um socket por interface
+// o controle (movimentos, anuncios, sondas, batimentos) fica no primeiro enlace, como antes,
+// e os frames dos objetos se espalham por todos; o receptor ja reordena pela sequencia
+// do outro lado cada enlace tem um MAC proprio, aprendido do primeiro frame valido que chega
+// por ele (o cliente se apresenta nos enlaces a mais com um TIPO_BATIMENTO)
+// cada MAC tem o seu Par (congestionamento.h), entao RTT, janela e ritmo sao medidos por enlace
+// cada frame vai no enlace que deve confirma-lo primeiro, pelo RTT e pela vazao medidos nele
+// um enlace que fica config.tentativas timeouts seguidos sem ACK sai da escala, os frames dele
+// vao pelos outros, e volta a receber um frame de teste a cada ENLACE_TESTE_MS
+#define ENLACE_TESTE_MS 1000
+#define MEDIDA_VALIDADE_MS 200 // sem ACK por mais que isso, o RTT e a vazao do enlace sao medidos de novo
+#define ENLACES_GRUPO JANELA_MAX // frames por grupo, cabe na janela do receptor
+
+typedef struct
+{
+    int sock;
+    const char *nome;
+    uchar mac_par[6];  // MAC do par visto por este enlace (o do primeiro vem de quem chama)
+    int conhece_par;
+    int caido;         // fora da escala ate um frame de teste ser confirmado
+    int falhas;        // timeouts seguidos
+    long long caiu_ns; // ultimo teste de um enlace caido
+    int em_voo;
+    // medidas da escala, pelo relogio local: o carimbo do kernel nao ve a fila de saida (qdisc)
+    long long rtt_min_ns; // menor ida e volta, com o enlace sem fila
+    long long servico_ns; // intervalo entre ACKs com o enlace ocupado: o inverso da vazao
+    long long ack_ns;     // ultimo ACK, e se ainda havia frame em voo depois dele
+    int ocupado;
+    long long frames;  // confirmados desde o ultimo enlaces_mostra
+    long long bytes;
+} Enlace;
+
+extern Enlace enlaces[ENLACES_MAX];
+extern int n_enlaces;
+
+int enlaces_abre(int sock);
+void enlaces_apresenta(void);
+void enlaces_colhe(void);
+int enlaces_recebe(BufferFrame **saida, const uchar *principal, int timeout_ms);
+int enlaces_envia_grupo(BufferFrame *frames[], int n, const uchar *principal, int timeout_ms);
+void enlaces_esquece(void);
+void enlaces_mostra(long long duracao_ns);
+
+#endif
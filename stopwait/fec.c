@@ -0,0 +1,379 @@
+#include "fec.h"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <tmmintrin.h>
+#define FEC_SSSE3 1
+#endif
+
+// aritmetica em GF(256) com o polinomio x^8 + x^4 + x^3 + x^2 + 1
+static uchar gf_exp[512];
+static uchar gf_log[256];
+// produtos de cada constante pelos nibbles baixo e alto, usados pelos kernels
+static uchar tabela_baixa[256][16];
+static uchar tabela_alta[256][16];
+static int gf_pronto = 0;
+
+// dst ^= c * src, escolhido em tempo de execucao conforme a CPU
+static void (*mul_acumula)(uchar *dst, const uchar *src, uchar c, int tam);
+
+static uchar gf_mul(uchar a, uchar b)
+{
+    if (a == 0 || b == 0)
+        return 0;
+    return gf_exp[gf_log[a] + gf_log[b]];
+}
+
+static uchar gf_inv(uchar a)
+{
+    return gf_exp[255 - gf_log[a]];
+}
+
+static void mul_acumula_escalar(uchar *dst, const uchar *src, uchar c, int tam)
+{
+    if (c == 0)
+        return;
+    if (c == 1)
+    {
+        for (int i = 0; i < tam; i++)
+            dst[i] ^= src[i];
+        return;
+    }
+    const uchar *baixa = tabela_baixa[c];
+    const uchar *alta = tabela_alta[c];
+    for (int i = 0; i < tam; i++)
+        dst[i] ^= baixa[src[i] & 0x0F] ^ alta[src[i] >> 4];
+}
+
+#ifdef FEC_SSSE3
+// multiplica 16 bytes por vez, usando pshufb como tabela de 16 entradas por nibble
+__attribute__((target("ssse3")))
+static void mul_acumula_ssse3(uchar *dst, const uchar *src, uchar c, int tam)
+{
+    if (c == 0)
+        return;
+    __m128i baixa = _mm_loadu_si128((const __m128i *)tabela_baixa[c]);
+    __m128i alta = _mm_loadu_si128((const __m128i *)tabela_alta[c]);
+    __m128i mascara = _mm_set1_epi8(0x0F);
+    int i = 0;
+    for (; i + 16 <= tam; i += 16)
+    {
+        __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+        __m128i pb = _mm_shuffle_epi8(baixa, _mm_and_si128(s, mascara));
+        __m128i pa = _mm_shuffle_epi8(alta, _mm_and_si128(_mm_srli_epi64(s, 4), mascara));
+        d = _mm_xor_si128(d, _mm_xor_si128(pb, pa));
+        _mm_storeu_si128((__m128i *)(dst + i), d);
+    }
+    mul_acumula_escalar(dst + i, src + i, c, tam - i);
+}
+#endif
+
+// monta as tabelas uma unica vez
+static void gf_inicia(void)
+{
+    if (gf_pronto)
+        return;
+
+    int x = 1;
+    for (int i = 0; i < 255; i++)
+    {
+        gf_exp[i] = x;
+        gf_log[x] = i;
+        x <<= 1;
+        if (x & 0x100)
+            x ^= 0x11D;
+    }
+    for (int i = 255; i < 512; i++)
+        gf_exp[i] = gf_exp[i - 255];
+
+    for (int c = 0; c < 256; c++)
+    {
+        for (int v = 0; v < 16; v++)
+        {
+            tabela_baixa[c][v] = gf_mul(c, v);
+            tabela_alta[c][v] = gf_mul(c, v << 4);
+        }
+    }
+
+    mul_acumula = mul_acumula_escalar;
+#ifdef FEC_SSSE3
+    if (__builtin_cpu_supports("ssse3"))
+        mul_acumula = mul_acumula_ssse3;
+#endif
+    gf_pronto = 1;
+}
+
+// coeficiente da paridade j sobre o frame i
+// no RS e a matriz de Cauchy 1 / (x_j + y_i), com x_j = 15 + j e y_i = i,
+// assim qualquer submatriz quadrada e inversivel
+static uchar coeficiente(int modo, int j, int i)
+{
+    if (modo == FEC_XOR)
+        return 1;
+    return gf_inv((FEC_MAX_DADOS + j) ^ i);
+}
+
+// acumula c * fragmento de um frame de dados em 'destino'
+// fragmento = tamanho seguido dos dados, completado com zeros (que nao contribuem)
+static void acumula_fragmento(uchar *destino, const BufferFrame *b, uchar c)
+{
+    uchar tamanho = buffer_tamanho(b);
+    destino[0] ^= gf_mul(c, tamanho);
+    mul_acumula(destino + 1, buffer_dados_c(b), c, tamanho);
+}
+
+// inverte a matriz m x m em GF(256) por Gauss-Jordan, retorna 0 se for singular
+static int gf_inverte(uchar a[FEC_MAX_PARIDADE][FEC_MAX_PARIDADE],
+                      uchar inv[FEC_MAX_PARIDADE][FEC_MAX_PARIDADE], int m)
+{
+    for (int i = 0; i < m; i++)
+        for (int j = 0; j < m; j++)
+            inv[i][j] = (i == j);
+
+    for (int col = 0; col < m; col++)
+    {
+        // procura um pivo nao nulo
+        int pivo = col;
+        while (pivo < m && a[pivo][col] == 0)
+            pivo++;
+        if (pivo == m)
+            return 0;
+        for (int j = 0; j < m; j++)
+        {
+            uchar t = a[col][j]; a[col][j] = a[pivo][j]; a[pivo][j] = t;
+            t = inv[col][j]; inv[col][j] = inv[pivo][j]; inv[pivo][j] = t;
+        }
+
+        // normaliza a linha do pivo
+        uchar fator = gf_inv(a[col][col]);
+        for (int j = 0; j < m; j++)
+        {
+            a[col][j] = gf_mul(a[col][j], fator);
+            inv[col][j] = gf_mul(inv[col][j], fator);
+        }
+
+        // zera a coluna nas outras linhas (soma e subtracao sao XOR)
+        for (int i = 0; i < m; i++)
+        {
+            if (i == col || a[i][col] == 0)
+                continue;
+            uchar f = a[i][col];
+            for (int j = 0; j < m; j++)
+            {
+                a[i][j] ^= gf_mul(f, a[col][j]);
+                inv[i][j] ^= gf_mul(f, inv[col][j]);
+            }
+        }
+    }
+    return 1;
+}
+
+// gera as paridades de um grupo de n frames de dados com sequencias consecutivas
+// cada paridade vai num buffer novo do pool; retorna quantas foram geradas
+int fec_codifica(const ConfigFEC *cfg, BufferFrame *dados[], int n, BufferFrame *paridades[])
+{
+    if (cfg->modo == FEC_DESLIGADO || n <= 0)
+        return 0;
+    gf_inicia();
+
+    int k = cfg->modo == FEC_XOR ? 1 : cfg->k;
+    uchar base = buffer_sequencia(dados[0]);
+
+    // o fragmento cobre o maior frame do grupo, a paridade nao passa do payload da sessao
+    int fragmento = 0;
+    for (int i = 0; i < n; i++)
+        if (buffer_tamanho(dados[i]) + 1 > fragmento)
+            fragmento = buffer_tamanho(dados[i]) + 1;
+
+    for (int j = 0; j < k; j++)
+    {
+        BufferFrame *p = buffer_aloca();
+        if (!p)
+            return j;
+
+        // cabecalho: base do grupo, n e k, modo e indice da paridade
+        uchar *carga = buffer_dados(p);
+        memset(carga, 0, FEC_CABECALHO + fragmento);
+        carga[0] = base;
+        carga[1] = n | (k << 4);
+        carga[2] = (cfg->modo << 4) | j;
+        for (int i = 0; i < n; i++)
+            acumula_fragmento(carga + FEC_CABECALHO, dados[i], coeficiente(cfg->modo, j, i));
+        buffer_monta(p, base, TIPO_PARIDADE, carga, FEC_CABECALHO + fragmento);
+        paridades[j] = p;
+    }
+    return k;
+}
+
+// atualiza a perda medida com o resultado de um grupo e ajusta a redundancia
+void fec_ajusta(ConfigFEC *cfg, int perdidos, int n)
+{
+    if (n <= 0)
+        return;
+    cfg->perda = 0.875 * cfg->perda + 0.125 * ((double)perdidos / n);
+    if (!cfg->adaptativo)
+        return;
+
+    if (cfg->modo == FEC_XOR)
+    {
+        // grupos menores quando ha mais perda, para caber uma perda por grupo
+        int n_novo = cfg->perda > 0 ? (int)(0.5 / cfg->perda) : FEC_MAX_DADOS;
+        cfg->n = n_novo < 2 ? 2 : (n_novo > FEC_MAX_DADOS ? FEC_MAX_DADOS : n_novo);
+    }
+    else if (cfg->modo == FEC_RS)
+    {
+        // paridades para o dobro das perdas esperadas no grupo
+        int k_novo = (int)(2 * cfg->perda * cfg->n + 0.999);
+        cfg->k = k_novo < 1 ? 1 : (k_novo > FEC_MAX_PARIDADE ? FEC_MAX_PARIDADE : k_novo);
+    }
+}
+
+void fec_inicia(DecodificadorFEC *d)
+{
+    gf_inicia();
+    memset(d->fragmentos, 0, sizeof(d->fragmentos));
+    memset(d->paridades, 0, sizeof(d->paridades));
+    d->base = -1;
+}
+
+// descarta as paridades guardadas
+static void solta_paridades(DecodificadorFEC *d)
+{
+    for (int j = 0; j < FEC_MAX_PARIDADE; j++)
+    {
+        buffer_solta(d->paridades[j]);
+        d->paridades[j] = NULL;
+    }
+    d->base = -1;
+}
+
+// devolve ao pool tudo o que o decodificador ainda guarda
+void fec_termina(DecodificadorFEC *d)
+{
+    for (int i = 0; i < ESPACO_SEQUENCIA; i++)
+    {
+        buffer_solta(d->fragmentos[i]);
+        d->fragmentos[i] = NULL;
+    }
+    solta_paridades(d);
+}
+
+// guarda uma referencia a um frame de dados recebido
+void fec_guarda_dados(DecodificadorFEC *d, BufferFrame *frame)
+{
+    if (buffer_tipo(frame) != 5)
+        return;
+    uchar idx = buffer_sequencia(frame) % ESPACO_SEQUENCIA;
+
+    // frame de fora do grupo das paridades guardadas: o emissor ja passou para
+    // o proximo grupo e a base pode se repetir com a volta da sequencia
+    if (d->base >= 0 && (idx - d->base + ESPACO_SEQUENCIA) % ESPACO_SEQUENCIA >= d->n)
+        solta_paridades(d);
+
+    buffer_ref(frame);
+    buffer_solta(d->fragmentos[idx]);
+    d->fragmentos[idx] = frame;
+
+    // a sequencia meia volta a frente e de um grupo antigo, nao vale mais
+    uchar antigo = (idx + ESPACO_SEQUENCIA / 2) % ESPACO_SEQUENCIA;
+    buffer_solta(d->fragmentos[antigo]);
+    d->fragmentos[antigo] = NULL;
+}
+
+// guarda uma paridade e reconstroi os frames que faltam no grupo, se possivel
+// os recuperados vao em buffers novos em 'recuperados' (quem chama os solta)
+// retorna quantos frames foram recuperados
+int fec_recupera(DecodificadorFEC *d, BufferFrame *paridade, BufferFrame *recuperados[])
+{
+    // o fragmento tem o tamanho do maior frame do grupo
+    int fragmento_n = buffer_tamanho(paridade) - FEC_CABECALHO;
+    if (fragmento_n < 1)
+        return 0;
+    const uchar *carga = buffer_dados(paridade);
+    int base = carga[0] % ESPACO_SEQUENCIA;
+    int n = carga[1] & 0x0F;
+    int k = carga[1] >> 4;
+    int modo = carga[2] >> 4;
+    int j = carga[2] & 0x0F;
+    if (n == 0 || k == 0 || k > FEC_MAX_PARIDADE || j >= k)
+        return 0;
+
+    // paridade de outro grupo descarta as anteriores
+    if (d->base != base)
+    {
+        solta_paridades(d);
+        d->base = base;
+        d->n = n;
+    }
+    buffer_ref(paridade);
+    buffer_solta(d->paridades[j]);
+    d->paridades[j] = paridade;
+
+    // quais frames do grupo faltam
+    int faltando[FEC_MAX_PARIDADE];
+    int m = 0;
+    for (int i = 0; i < n; i++)
+    {
+        if (!d->fragmentos[(base + i) % ESPACO_SEQUENCIA])
+        {
+            if (m == k)
+                return 0; // mais perdas do que paridades
+            faltando[m++] = i;
+        }
+    }
+    if (m == 0)
+        return 0;
+
+    // precisa de uma paridade por frame perdido
+    int usadas[FEC_MAX_PARIDADE];
+    int u = 0;
+    for (int p = 0; p < k && u < m; p++)
+        if (d->paridades[p])
+            usadas[u++] = p;
+    if (u < m)
+        return 0;
+
+    // tira de cada paridade a contribuicao dos frames que chegaram
+    uchar sindromes[FEC_MAX_PARIDADE][FEC_FRAGMENTO] = {{0}};
+    for (int r = 0; r < m; r++)
+    {
+        BufferFrame *p = d->paridades[usadas[r]];
+        if (buffer_tamanho(p) != buffer_tamanho(paridade))
+            return 0; // paridades do mesmo grupo tem o mesmo tamanho
+        memcpy(sindromes[r], buffer_dados(p) + FEC_CABECALHO, fragmento_n);
+        for (int i = 0; i < n; i++)
+        {
+            BufferFrame *f = d->fragmentos[(base + i) % ESPACO_SEQUENCIA];
+            if (f)
+                acumula_fragmento(sindromes[r], f, coeficiente(modo, usadas[r], i));
+        }
+    }
+
+    // resolve o sistema com os coeficientes dos frames perdidos
+    uchar a[FEC_MAX_PARIDADE][FEC_MAX_PARIDADE];
+    uchar inv[FEC_MAX_PARIDADE][FEC_MAX_PARIDADE];
+    for (int r = 0; r < m; r++)
+        for (int c = 0; c < m; c++)
+            a[r][c] = coeficiente(modo, usadas[r], faltando[c]);
+    if (!gf_inverte(a, inv, m))
+        return 0;
+
+    int recuperados_n = 0;
+    for (int c = 0; c < m; c++)
+    {
+        uchar fragmento[FEC_FRAGMENTO] = {0};
+        for (int r = 0; r < m; r++)
+            mul_acumula(fragmento, sindromes[r], inv[c][r], FEC_FRAGMENTO);
+        if (fragmento[0] > fragmento_n - 1)
+            continue; // paridade inconsistente
+
+        BufferFrame *f = buffer_aloca();
+        if (!f)
+            break;
+        buffer_monta(f, (base + faltando[c]) % ESPACO_SEQUENCIA, 5, fragmento + 1, fragmento[0]);
+        fec_guarda_dados(d, f);
+        recuperados[recuperados_n++] = f;
+    }
+    return recuperados_n;
+}
@@ -0,0 +1,46 @@
+#ifndef FEC_H
+#define FEC_H
+
+#include "protocolo.h"
+#include "buffer.h"
+
+// modos de correcao de erros
+#define FEC_DESLIGADO 0
+#define FEC_XOR 1 // uma paridade por grupo, XOR de todos os frames
+#define FEC_RS 2  // Reed-Solomon (Cauchy) em GF(256), ate FEC_MAX_PARIDADE paridades
+
+#define FEC_MAX_DADOS 15   // frames de dados por grupo (cabe na janela de recepcao)
+#define FEC_MAX_PARIDADE 4 // frames de paridade por grupo
+#define FEC_CABECALHO 3    // base, n/k, modo/indice
+#define FEC_FRAGMENTO (MAX_DADOS - FEC_CABECALHO)   // maior fragmento: tamanho + dados de um frame
+#define FEC_DADOS_POR_FRAME (FEC_FRAGMENTO - 1)     // payload de dados com FEC ligada
+
+// configuracao do emissor
+typedef struct {
+    int modo;       // FEC_DESLIGADO, FEC_XOR ou FEC_RS
+    int n;          // frames de dados por grupo
+    int k;          // frames de paridade por grupo (RS)
+    int adaptativo; // ajusta n (XOR) ou k (RS) pela perda medida
+    double perda;   // media movel da fracao de frames perdidos
+} ConfigFEC;
+
+// estado do receptor: frames recentes por sequencia e paridades do grupo atual
+// guarda referencias aos proprios buffers recebidos, sem copiar
+typedef struct {
+    BufferFrame *fragmentos[ESPACO_SEQUENCIA];
+    int base; // grupo das paridades guardadas, -1 se nenhum
+    int n;    // frames de dados desse grupo
+    BufferFrame *paridades[FEC_MAX_PARIDADE];
+} DecodificadorFEC;
+
+// emissor
+int fec_codifica(const ConfigFEC *cfg, BufferFrame *dados[], int n, BufferFrame *paridades[]);
+void fec_ajusta(ConfigFEC *cfg, int perdidos, int n);
+
+// receptor
+void fec_inicia(DecodificadorFEC *d);
+void fec_termina(DecodificadorFEC *d);
+void fec_guarda_dados(DecodificadorFEC *d, BufferFrame *frame);
+int fec_recupera(DecodificadorFEC *d, BufferFrame *paridade, BufferFrame *recuperados[]);
+
+#endif
@@ -0,0 +1,97 @@
+#define _GNU_SOURCE // sched_setaffinity
+#include "giro.h"
+#include "protocolo.h"
+#include "config.h"
+#include "uring.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <linux/if_packet.h>
+
+static int ativo;
+static cpu_set_t original; // CPUs do processo antes de prender a thread
+
+// prende a thread que chama (a do protocolo) e ajusta o socket; sem config.cpu nao faz nada
+// retorna -1 se o modo nao ficou ativo
+int giro_inicia(int sock)
+{
+    if (config.cpu < 0)
+        return -1;
+    cpu_set_t cpu;
+    CPU_ZERO(&cpu);
+    CPU_SET(config.cpu, &cpu);
+    // com varios enlaces so o primeiro socket prende a thread, os outros so ajustam o socket
+    if (!ativo && (sched_getaffinity(0, sizeof(original), &original) != 0 ||
+                   sched_setaffinity(0, sizeof(cpu), &cpu) != 0))
+    {
+        fprintf(stderr, "Aviso: CPU %d indisponivel (%s), sem o modo de giro\n", config.cpu, strerror(errno));
+        return -1;
+    }
+
+    // as opcoes so ajudam; sem elas (ou sem CAP_NET_ADMIN) o giro em espaco do usuario continua valendo
+    int giro = config.giro_us;
+    if (setsockopt(sock, SOL_SOCKET, SO_BUSY_POLL, &giro, sizeof(giro)) != 0)
+        fprintf(stderr, "Aviso: SO_BUSY_POLL recusado: %s\n", strerror(errno));
+    int direto = 1, dominio = 0;
+    socklen_t tamanho = sizeof(dominio);
+    getsockopt(sock, SOL_SOCKET, SO_DOMAIN, &dominio, &tamanho);
+    if (dominio == AF_PACKET &&
+        setsockopt(sock, SOL_PACKET, PACKET_QDISC_BYPASS, &direto, sizeof(direto)) != 0)
+        fprintf(stderr, "Aviso: PACKET_QDISC_BYPASS recusado: %s\n", strerror(errno));
+    ativo = 1;
+    return 0;
+}
+
+int giro_ativo(void)
+{
+    return ativo;
+}
+
+// intervalo curto entre consultas, sem ceder a CPU: um sched_yield empurraria o prazo da
+// thread no escalonador, e o proximo acordar dela (quando o giro acaba) chegaria atrasado
+static inline void pausa(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ volatile("yield");
+#endif
+}
+
+// consulta o socket sem dormir ate chegar algo, ate o fim do orcamento ou do prazo
+// retorna 1 se ha dados, 0 se quem chamou deve dormir pelo resto do prazo
+int giro_espera(int sock, long long timeout_ms)
+{
+    long long orcamento_ns = (long long)config.giro_us * 1000;
+    if (orcamento_ns > timeout_ms * 1000000LL)
+        orcamento_ns = timeout_ms * 1000000LL;
+    long long fim = timestamp_ns() + orcamento_ns;
+    struct pollfd pfd = {.fd = sock, .events = POLLIN};
+    do
+    {
+        if (uring_ativo(sock) ? uring_consulta(sock) : poll(&pfd, 1, 0) > 0)
+            return 1;
+        pausa();
+    } while (timestamp_ns() < fim);
+    return 0;
+}
+
+// threads e processos criados depois herdam a CPU presa; 'livre' devolve a thread que chama
+// as CPUs originais (gravacao, visualizadores), e 0 a prende de novo
+void giro_livre(int livre)
+{
+    if (!ativo)
+        return;
+    if (livre)
+    {
+        sched_setaffinity(0, sizeof(original), &original);
+        return;
+    }
+    cpu_set_t cpu;
+    CPU_ZERO(&cpu);
+    CPU_SET(config.cpu, &cpu);
+    sched_setaffinity(0, sizeof(cpu), &cpu);
+}
@@ -0,0 +1,17 @@
+#ifndef GIRO_H
+#define GIRO_H
+
+// modo de baixa latencia, opcional (config.cpu >= 0): gasta uma CPU para nao pagar o acordar
+// a thread do protocolo fica presa a config.cpu e, antes de dormir esperando o socket,
+// consulta sem bloquear por ate config.giro_us
+// o socket pede SO_BUSY_POLL (o kernel consulta a fila da placa em vez de esperar a
+// interrupcao) e PACKET_QDISC_BYPASS (o envio vai direto ao driver, sem a fila do qdisc)
+#define GIRO_PADRAO_US 200 // orcamento de giro por espera
+#define GIRO_MAX_US 10000000
+
+int giro_inicia(int sock);
+int giro_ativo(void);
+int giro_espera(int sock, long long timeout_ms);
+void giro_livre(int livre);
+
+#endif
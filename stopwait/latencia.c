@@ -0,0 +1,29 @@
+#include "latencia.h"
+#include <stdlib.h>
+#include <string.h>
+
+void latencia_anota(Latencias *l, long long ns)
+{
+    l->amostras[l->total++ % LATENCIA_AMOSTRAS] = ns;
+}
+
+static int compara(const void *a, const void *b)
+{
+    long long x = *(const long long *)a, y = *(const long long *)b;
+    return x < y ? -1 : x > y;
+}
+
+// mediana, p99 e maximo, em us, ordenando uma copia; retorna quantas amostras entraram
+int latencia_percentis(const Latencias *l, double *mediana_us, double *p99_us, double *max_us)
+{
+    int n = l->total < LATENCIA_AMOSTRAS ? (int)l->total : LATENCIA_AMOSTRAS;
+    if (n == 0)
+        return 0;
+    long long ordenadas[LATENCIA_AMOSTRAS];
+    memcpy(ordenadas, l->amostras, n * sizeof(ordenadas[0]));
+    qsort(ordenadas, n, sizeof(ordenadas[0]), compara);
+    *mediana_us = ordenadas[n / 2] / 1e3;
+    *p99_us = ordenadas[(n * 99) / 100] / 1e3;
+    *max_us = ordenadas[n - 1] / 1e3;
+    return n;
+}
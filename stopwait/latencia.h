@@ -0,0 +1,16 @@
+#ifndef LATENCIA_H
+#define LATENCIA_H
+
+// amostras de latencia (movimento ate o ACK no cliente, ida e volta no bench),
+// guardadas num anel; os percentis saem das ultimas LATENCIA_AMOSTRAS
+#define LATENCIA_AMOSTRAS 4096
+
+typedef struct {
+    long long amostras[LATENCIA_AMOSTRAS]; // ns
+    long long total; // amostras anotadas, inclusive as que o anel ja perdeu
+} Latencias;
+
+void latencia_anota(Latencias *l, long long ns);
+int latencia_percentis(const Latencias *l, double *mediana_us, double *p99_us, double *max_us);
+
+#endif
@@ -0,0 +1,117 @@
+#include "mapa.h"
+#include "sorteio.h"
+#include <stdlib.h>
+#include <string.h>
+
+int celulas_inicia(Celulas *c, long long n)
+{
+    c->palavras = (n + 63) / 64;
+    c->bits = calloc(c->palavras, sizeof(uint64_t));
+    return c->bits ? 0 : -1;
+}
+
+void celulas_termina(Celulas *c)
+{
+    free(c->bits);
+    c->bits = NULL;
+}
+
+void celulas_limpa(Celulas *c)
+{
+    memset(c->bits, 0, c->palavras * sizeof(uint64_t));
+}
+
+// enterra 'tesouros' em celulas distintas pelo algoritmo de Floyd:
+// um sorteio por tesouro, sem repetir sorteios de posicao ja usada
+static void sorteia(Mapa *m, uint64_t semente)
+{
+    long long n = (long long)m->largura * m->altura;
+    for (long long j = n - m->tesouros; j < n; j++)
+    {
+        long long t = (long long)sorteio_ate(&semente, j + 1);
+        celulas_liga(&m->todos, celulas_tem(&m->todos, t) ? j : t);
+    }
+}
+
+// a mesma semente enterra os tesouros nas mesmas celulas
+// retorna -1 se nao ha memoria ou os tesouros nao cabem no mapa
+int mapa_inicia(Mapa *m, int largura, int altura, int tesouros, uint64_t semente)
+{
+    long long n = (long long)largura * altura;
+    memset(m, 0, sizeof(*m));
+    if (largura < 1 || altura < 1 || largura > LADO_MAX || altura > LADO_MAX || tesouros < 0 || tesouros > n)
+        return -1;
+    m->largura = largura;
+    m->altura = altura;
+    m->tesouros = tesouros;
+    m->restam = tesouros;
+    if (celulas_inicia(&m->todos, n) != 0 || celulas_inicia(&m->restantes, n) != 0 ||
+        !(m->antes = malloc(m->todos.palavras * sizeof(int))))
+    {
+        mapa_termina(m);
+        return -1;
+    }
+
+    sorteia(m, semente);
+    memcpy(m->restantes.bits, m->todos.bits, m->todos.palavras * sizeof(uint64_t));
+    int soma = 0;
+    for (int w = 0; w < m->todos.palavras; w++)
+    {
+        m->antes[w] = soma;
+        soma += __builtin_popcountll(m->todos.bits[w]);
+    }
+    return 0;
+}
+
+void mapa_termina(Mapa *m)
+{
+    celulas_termina(&m->todos);
+    celulas_termina(&m->restantes);
+    free(m->antes);
+    m->antes = NULL;
+}
+
+int mapa_tesouro(const Mapa *m, int x, int y)
+{
+    if (!mapa_dentro(m, x, y))
+        return -1;
+    long long i = mapa_celula(m, x, y);
+    if (!celulas_tem(&m->restantes, i))
+        return -1;
+    uint64_t abaixo = (1ULL << (i & 63)) - 1;
+    return m->antes[i >> 6] + __builtin_popcountll(m->todos.bits[i >> 6] & abaixo);
+}
+
+void mapa_coleta(Mapa *m, int x, int y)
+{
+    if (mapa_dentro(m, x, y) && celulas_tem(&m->restantes, mapa_celula(m, x, y)))
+    {
+        celulas_desliga(&m->restantes, mapa_celula(m, x, y));
+        m->restam--;
+    }
+}
+
+// posicao do tesouro 'indice' (para listar), busca binaria em 'antes'
+// retorna 1 se ainda nao foi coletado, -1 se o indice nao existe
+int mapa_posicao(const Mapa *m, int indice, int *x, int *y)
+{
+    if (indice < 0 || indice >= m->tesouros)
+        return -1;
+    int a = 0, b = m->todos.palavras - 1;
+    while (a < b)
+    {
+        int meio = (a + b + 1) / 2;
+        if (m->antes[meio] <= indice)
+            a = meio;
+        else
+            b = meio - 1;
+    }
+    // o (indice - antes)-esimo bit ligado da palavra
+    uint64_t palavra = m->todos.bits[a];
+    for (int k = indice - m->antes[a]; k > 0; k--)
+        palavra &= palavra - 1;
+    long long i = (long long)a * 64 + __builtin_ctzll(palavra);
+    *x = i % m->largura;
+    *y = i / m->largura;
+    return celulas_tem(&m->restantes, i);
+}
@@ -0,0 +1,49 @@
+#ifndef MAPA_H
+#define MAPA_H
+
+#include <stdint.h>
+
+#define LARGURA_PADRAO 8
+#define ALTURA_PADRAO 8
+#define TESOUROS_PADRAO 8
+#define LADO_MAX 4096 // bitsets de ate 2 MB por conjunto
+
+// conjunto de celulas, um bit por celula em ordem de linha (x + y * largura)
+// no mapa 8x8 e um unico uint64 (bitboard)
+typedef struct {
+    int palavras;
+    uint64_t *bits;
+} Celulas;
+
+int celulas_inicia(Celulas *c, long long n);
+void celulas_termina(Celulas *c);
+void celulas_limpa(Celulas *c);
+
+static inline int celulas_tem(const Celulas *c, long long i) { return (c->bits[i >> 6] >> (i & 63)) & 1; }
+static inline void celulas_liga(Celulas *c, long long i) { c->bits[i >> 6] |= 1ULL << (i & 63); }
+static inline void celulas_desliga(Celulas *c, long long i) { c->bits[i >> 6] &= ~(1ULL << (i & 63)); }
+
+// estado do jogo no servidor
+// o indice de um tesouro e a sua ordem em 'todos', achada com popcount sem percorrer a lista
+typedef struct {
+    int largura, altura;
+    int tesouros;
+    int restam;         // nao coletados
+    Celulas todos;      // onde ha tesouro enterrado
+    Celulas restantes;  // os ainda nao coletados
+    int *antes;         // tesouros nas palavras anteriores de 'todos'
+} Mapa;
+
+int mapa_inicia(Mapa *m, int largura, int altura, int tesouros, uint64_t semente);
+void mapa_termina(Mapa *m);
+int mapa_tesouro(const Mapa *m, int x, int y); // indice se ha tesouro nao coletado, senao -1
+void mapa_coleta(Mapa *m, int x, int y);
+int mapa_posicao(const Mapa *m, int indice, int *x, int *y);
+
+static inline long long mapa_celula(const Mapa *m, int x, int y) { return x + (long long)y * m->largura; }
+static inline int mapa_dentro(const Mapa *m, int x, int y)
+{
+    return x >= 0 && y >= 0 && x < m->largura && y < m->altura;
+}
+
+#endif
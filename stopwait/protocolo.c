@@ -0,0 +1,639 @@
+#include "protocolo.h"
+#include "congestionamento.h"
+#include "buffer.h"
+#include "uring.h"
+#include "carimbo.h"
+#include "config.h"
+#include "registro.h"
+#include "batimento.h"
+#include "giro.h"
+#include "simulacao.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <linux/if_packet.h>
+#include <net/ethernet.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <sys/time.h>
+#include <time.h>
+#include <poll.h>
+
+// cria o frame
+Frame criar_frame(uchar sequencia, uchar tipo, uchar *dados, uchar tamanho)
+{
+    Frame frame;
+    frame.marcador_inicio = MARCADOR_INICIO;
+    frame.tamanho = tamanho;
+    frame.sequencia = sequencia & 0x1F; // 5 bits
+    frame.tipo = tipo & 0x0F;           // 4 bits
+
+    // copia payload se houver
+    if (tamanho > 0 && dados != NULL)
+    {
+        memcpy(frame.dados, dados, tamanho);
+    }
+
+    // adiciona o checksum ao frame
+    frame.checksum = calcular_checksum(&frame);
+    return frame;
+}
+
+// imprime os campos da frame (USADO PARA DEBUG APENAS)
+void print_frame(Frame *frame)
+{
+    printf("---- Frame ----\n");
+    printf("Inicio: 0x%02X\n", frame->marcador_inicio);
+    printf("Tamanho: %d\n", frame->tamanho);
+    printf("Sequencia: %d\n", frame->sequencia);
+    printf("Tipo: %d\n", frame->tipo);
+    printf("Checksum: 0x%02X (%s)\n", frame->checksum,
+           verificar_checksum(frame) ? "OK" : "ERRO");
+
+    printf("Dados: ");
+    for (int i = 0; i < frame->tamanho; i++)
+    {
+        printf("%02X ", frame->dados[i]);
+    }
+    printf("\n----------------\n");
+}
+
+// MAC de cada interface, lido uma vez em cria_raw_socket (indexado pelo socket)
+static uchar mac_local[MAX_SOCKETS][6];
+
+// monta o cabecalho Ethernet do par, usado em todos os frames para ele
+static void monta_cabecalho(Par *par, int socket_fd)
+{
+    struct ether_header *eth = (struct ether_header *)par->cabecalho;
+    memcpy(eth->ether_dhost, par->mac, 6); // MAC de destino
+    if (socket_fd >= 0 && socket_fd < MAX_SOCKETS)
+        memcpy(eth->ether_shost, mac_local[socket_fd], 6); // MAC origem
+    else
+        memset(eth->ether_shost, 0xff, 6);
+    eth->ether_type = htons(ETHERTYPE_CUSTOM); // tipo customizado
+    par->cabecalho_sock = socket_fd;
+}
+
+// escreve cabecalho do protocolo e payload a partir de 'destino', retorna quantos bytes
+int serializa_frame(uchar *destino, const Frame *frame)
+{
+    destino[0] = frame->marcador_inicio;
+    destino[1] = frame->tamanho;
+    destino[2] = frame->sequencia;
+    destino[3] = frame->tipo;
+    destino[4] = frame->checksum;
+    memcpy(&destino[5], frame->dados, frame->tamanho);
+    return 5 + frame->tamanho;
+}
+
+// frames que esperam resposta levam carimbo de envio, para medir o RTT
+static int espera_resposta(uchar tipo)
+{
+    return tipo != 0 && tipo != 1 && tipo != TIPO_PARIDADE && tipo != TIPO_TEM && tipo != TIPO_BATIMENTO;
+}
+
+// envia um frame ja montado no buffer, completando o cabecalho Ethernet do par
+int enviar_buffer(int socket_fd, BufferFrame *b, const uchar *dest_mac)
+{
+    // copia o cabecalho Ethernet pronto do par
+    Par *par = par_busca(dest_mac);
+    par->enviado_ns = par->usado_ns;
+    if (par->cabecalho_sock != socket_fd)
+        monta_cabecalho(par, socket_fd);
+    memcpy(b->rede, par->cabecalho, TAMANHO_ETH);
+
+    // socket simulado: o frame vai pelo enlace da simulacao (simulacao.h)
+    if (sim_socket(socket_fd))
+        return sim_envia(socket_fd, b);
+
+    int carimbar = carimbo_ativo(socket_fd) && espera_resposta(buffer_tipo(b));
+    if (carimbar)
+        carimbo_envio(socket_fd, buffer_sequencia(b));
+
+    // com io_uring o envio entra no anel, o erro aparece na conclusao
+    if (uring_ativo(socket_fd))
+        return uring_envia(socket_fd, b, carimbar);
+
+    // envia, pedindo o carimbo pela mensagem de controle
+    uchar controle[CONTROLE_CARIMBO];
+    struct iovec iov = {b->rede, buffer_total(b)};
+    struct msghdr m = {0};
+    m.msg_iov = &iov;
+    m.msg_iovlen = 1;
+    if (carimbar)
+    {
+        m.msg_control = controle;
+        m.msg_controllen = carimbo_controle(controle);
+    }
+    if (sendmsg(socket_fd, &m, 0) == -1)
+    {
+        perror("Erro ao enviar frame");
+        return -1;
+    }
+    return 0;
+}
+
+// monta e envia um frame
+int enviar_frame(int socket_fd, const Frame *frame, const uchar *dest_mac)
+{
+    BufferFrame *b = buffer_de_frame(frame);
+    if (!b)
+        return -1;
+    int ret = enviar_buffer(socket_fd, b, dest_mac);
+    buffer_solta(b);
+    return ret;
+}
+
+// recebe um frame direto num buffer do pool
+// retorna 0 se valido, -2 se o checksum nao bate (o buffer volta para o NACK)
+// e -1 se nada util chegou (sem buffer)
+int receber_buffer(int socket_fd, BufferFrame **saida, const uchar *filtro_mac)
+{
+    *saida = NULL;
+    BufferFrame *b;
+    int n;
+    struct sockaddr_ll origem = {0};
+    if (sim_socket(socket_fd))
+    {
+        if (!(b = sim_recebe(socket_fd, &n)))
+            return -1;
+    }
+    else if (uring_ativo(socket_fd))
+    {
+        // o frame ja esta num buffer do pool, entregue pela recepcao multishot
+        if (!(b = uring_recebe(socket_fd, &n)))
+            return -1;
+    }
+    else
+    {
+        if (!(b = buffer_aloca()))
+            return -1;
+        // sem bloquear: o poll tambem acorda por carimbos de envio na fila de erros
+        uchar controle[CONTROLE_CARIMBO];
+        struct iovec iov = {b->rede, sizeof(b->rede)};
+        struct msghdr m = {0};
+        m.msg_name = &origem;
+        m.msg_namelen = sizeof(origem);
+        m.msg_iov = &iov;
+        m.msg_iovlen = 1;
+        m.msg_control = controle;
+        m.msg_controllen = sizeof(controle);
+        n = recvmsg(socket_fd, &m, MSG_DONTWAIT);
+        if (n < 0)
+            carimbo_colhe(socket_fd); // acordou so pela fila de erros
+        else
+            carimbo_recepcao(b, controle, m.msg_controllen);
+    }
+
+    // ignora os frames que nos mesmos enviamos (o raw socket tambem os recebe),
+    // os de outros protocolos, os para outro mac e os sem o marcador
+    struct ether_header *eth = (struct ether_header *)b->rede;
+    if (n < TAMANHO_ETH + 5 ||
+        origem.sll_pkttype == PACKET_OUTGOING ||
+        ntohs(eth->ether_type) != ETHERTYPE_CUSTOM ||
+        (filtro_mac && memcmp(eth->ether_dhost, filtro_mac, 6) != 0) ||
+        buffer_cabecalho(b)[0] != MARCADOR_INICIO ||
+        buffer_tamanho(b) > MAX_DADOS || n < buffer_total(b))
+    {
+        buffer_solta(b);
+        return -1;
+    }
+
+    *saida = b;
+    // retorna 0 se o checksum bater, -2 caso contrario
+    return buffer_checksum_ok(b) ? 0 : -2;
+}
+
+// recebe um frame e informa o MAC de quem enviou
+int receber_frame_de(int socket_fd, Frame *frame, const uchar *filtro_mac, uchar *mac_origem)
+{
+    BufferFrame *b;
+    int ret = receber_buffer(socket_fd, &b, filtro_mac);
+    if (!b)
+        return ret;
+    if (mac_origem)
+        memcpy(mac_origem, buffer_mac_origem(b), 6);
+    buffer_para_frame(b, frame);
+    buffer_solta(b);
+    return ret;
+}
+
+// cria o raw socket
+int cria_raw_socket(char *nome_interface_rede)
+{
+    // Cria arquivo para o socket sem qualquer protocolo
+    int soquete = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+    if (soquete == -1)
+    {
+        fprintf(stderr, "Erro ao criar socket: Verifique se você é root!\n");
+        exit(-1);
+    }
+
+    int ifindex = if_nametoindex(nome_interface_rede);
+
+    struct sockaddr_ll endereco = {0};
+    endereco.sll_family = AF_PACKET;
+    endereco.sll_protocol = htons(ETH_P_ALL);
+    endereco.sll_ifindex = ifindex;
+    // Inicializa socket
+    if (bind(soquete, (struct sockaddr *)&endereco, sizeof(endereco)) == -1)
+    {
+        fprintf(stderr, "Erro ao fazer bind no socket\n");
+        exit(-1);
+    }
+
+    // le o MAC da interface uma vez, para o cabecalho dos frames
+    struct ifreq ifr = {0};
+    strncpy(ifr.ifr_name, nome_interface_rede, IFNAMSIZ - 1);
+    if (soquete < MAX_SOCKETS && ioctl(soquete, SIOCGIFHWADDR, &ifr) == 0)
+        memcpy(mac_local[soquete], ifr.ifr_hwaddr.sa_data, 6);
+    else
+        fprintf(stderr, "Aviso: MAC da interface %s desconhecido\n", nome_interface_rede);
+
+    // carimbos de tempo do kernel para o RTT, e da placa se ela ja carimba ou se pedido
+    if (carimbo_ativa(soquete, nome_interface_rede, config.carimbo_hw) < 0)
+        fprintf(stderr, "Aviso: sem carimbos de tempo do kernel, RTT medido no espaco do usuario\n");
+
+    // modo de giro, se pedido: esta thread vira a do protocolo, presa a config.cpu
+    giro_inicia(soquete);
+
+    struct packet_mreq mr = {0};
+    mr.mr_ifindex = ifindex;
+    mr.mr_type = PACKET_MR_PROMISC;
+    // Não joga fora o que identifica como lixo: Modo promíscuo
+    if (setsockopt(soquete, SOL_PACKET, PACKET_ADD_MEMBERSHIP, &mr, sizeof(mr)) == -1)
+    {
+        fprintf(stderr, "Erro ao fazer setsockopt: "
+                        "Verifique se a interface de rede foi especificada corretamente.\n");
+        exit(-1);
+    }
+
+    // os frames que nos mesmos enviamos nao voltam para o socket
+    int ignora = 1;
+    setsockopt(soquete, SOL_PACKET, PACKET_IGNORE_OUTGOING, &ignora, sizeof(ignora));
+
+    return soquete;
+}
+
+// retorna o timestamp atual em ms
+long long timestamp_ms()
+{
+    if (sim_rodando)
+        return sim_agora_ns() / 1000000;
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (long long)(tv.tv_sec) * 1000 + (tv.tv_usec / 1000);
+}
+
+// retorna o timestamp atual em ns, de um relogio que nao volta no tempo
+long long timestamp_ns()
+{
+    if (sim_rodando)
+        return sim_agora_ns();
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// espera ate o socket ter algo para ler, sem bloquear alem do prazo
+// retorna 1 se ha dados, 0 se o prazo acabou
+int espera_dados(int sock, long long timeout_ms)
+{
+    if (sim_socket(sock))
+        return sim_espera(sock, timeout_ms);
+    // no modo de giro so dorme depois de consultar sem bloquear por config.giro_us
+    if (giro_ativo())
+    {
+        long long inicio = timestamp_ns();
+        if (giro_espera(sock, timeout_ms))
+            return 1;
+        timeout_ms -= (timestamp_ns() - inicio) / 1000000;
+        if (timeout_ms <= 0)
+            return 0;
+    }
+    if (uring_ativo(sock))
+        return uring_espera(sock, timeout_ms);
+    // tambem acorda com carimbos na fila de erros (POLLERR), que receber_buffer colhe
+    struct pollfd pfd = {.fd = sock, .events = POLLIN};
+    return poll(&pfd, 1, (int)timeout_ms) > 0;
+}
+
+// RTT de um frame respondido: pelos carimbos do kernel se houver, senao pelo relogio local
+// (enviado_ns e tomado antes do envio, entao o intervalo local sempre contem o do kernel)
+// retorna -1 se os carimbos mostram que a resposta e de um envio anterior
+long long mede_rtt(int sock, uchar sequencia, const BufferFrame *resposta, long long enviado_ns)
+{
+    long long local = timestamp_ns() - enviado_ns;
+    long long kernel = carimbo_rtt(sock, sequencia, resposta);
+    if (kernel == 0)
+        return -1;
+    return kernel > 0 && kernel <= local ? kernel : local;
+}
+
+// envia no ritmo do par; se o ritmo vai dormir, o lote ja montado segue antes
+// retorna o instante logo antes do envio, para o RTT
+static long long envia_no_ritmo(int sock, Par *par, BufferFrame *b, const uchar *dest_mac)
+{
+    if (ritmo_atraso_ns(par, buffer_total(b)) > 0)
+        uring_lote(0);
+    ritmo_espera(par, buffer_total(b));
+    uring_lote(1);
+    long long agora = timestamp_ns();
+    enviar_buffer(sock, b, dest_mac);
+    return agora;
+}
+
+// resposta que chegou enquanto esperamos o ACK: se e do par, conta como sinal de vida
+static void ouvido(Par *par, BufferFrame *resposta)
+{
+    if (memcmp(buffer_mac_origem(resposta), par->mac, 6) == 0)
+        batimento_ouvido(par, timestamp_ns());
+}
+
+// envia um frame e espera ACK/NACK, retrasmite caso de timeout ou NACK
+int enviar_com_ack(int sock, const Frame *frame, const uchar *dest_mac, int timeout_ms)
+{
+    BufferFrame *b = buffer_de_frame(frame);
+    if (!b)
+        return -1;
+    int ret = enviar_buffer_com_ack(sock, b, dest_mac, timeout_ms);
+    buffer_solta(b);
+    return ret;
+}
+
+// igual a enviar_com_ack, com o frame ja montado num buffer
+// retorna 0 com ACK, 1 se o par respondeu TIPO_TEM e -1 se esgotou as tentativas
+int enviar_buffer_com_ack(int sock, BufferFrame *b, const uchar *dest_mac, int timeout_ms)
+{
+    // maximo de config.tentativas envios
+    int tentativas = config.tentativas;
+    uchar seq_esperada = buffer_sequencia(b);
+    // estado de congestionamento do destino
+    Par *par = par_busca(dest_mac);
+    int retransmitido = 0;
+
+    while (tentativas--)
+    {
+        // envia o frame no ritmo do par
+        ritmo_espera(par, buffer_total(b));
+        long long t0 = timestamp_ms();
+        long long enviado_ns = timestamp_ns();
+        enviar_buffer(sock, b, dest_mac);
+        // aguarda resposta ate o timeout do par, limitado pelo da sessao
+        int espera_ms = cc_timeout_ms(par, timeout_ms);
+        long long restante;
+        int nack = 0;
+        while (!nack && (restante = espera_ms - (timestamp_ms() - t0)) > 0)
+        {
+            BufferFrame *resposta = NULL;
+            if (!espera_dados(sock, restante) || receber_buffer(sock, &resposta, NULL) != 0)
+            {
+                buffer_solta(resposta);
+                continue;
+            }
+            ouvido(par, resposta);
+            uchar tipo = buffer_tipo(resposta);
+            uchar seq = buffer_sequencia(resposta);
+
+            if ((tipo == 0 || tipo == TIPO_TEM) && seq == seq_esperada)
+            {
+                // RTT so vale se o ACK nao pode ser de uma retransmissao
+                long long rtt = retransmitido ? -1 : mede_rtt(sock, seq, resposta, enviado_ns);
+                if (rtt >= 0)
+                    cc_ack(par, rtt);
+                buffer_solta(resposta);
+                return tipo == TIPO_TEM; // ACK recebido
+            }
+            else if (tipo == 1 && seq == seq_esperada)
+            {
+                nack = 1; // NACK, reenvia
+            }
+            buffer_solta(resposta);
+        }
+        // se da timeout, reenvia, a nao ser que o par ja tenha sido dado como morto
+        if (timestamp_ms() - t0 >= espera_ms)
+        {
+            if (batimento_falhou(par))
+            {
+                registra(REG_AVISO, "Par sem sinal de vida, desistindo do frame");
+                return -1;
+            }
+            registra(REG_AVISO, "Timeout. Reenviando frame...");
+            cc_perda(par);
+        }
+        retransmitido = 1;
+    }
+    registra(REG_AVISO, "Sem resposta em %d tentativas, desistindo do frame", config.tentativas);
+    return -1; // falha apos todas as tentativas
+}
+
+// envia um grupo de frames, respeitando a janela de congestionamento do par, depois as
+// paridades, e espera o ACK de cada frame; so os que ficaram sem ACK sao retransmitidos
+// retorna quantos frames se perderam (recuperados pela paridade ou reenviados), ou -1 se falhar
+int enviar_grupo_com_ack(int sock, BufferFrame *frames[], int n, BufferFrame *paridades[], int k,
+                         const uchar *dest_mac, int timeout_ms)
+{
+    // maximo de config.tentativas timeouts seguidos sem nenhum ACK
+    int tentativas = config.tentativas;
+    Par *par = par_busca(dest_mac);
+    unsigned int pendentes = (1u << n) - 1; // bit i ligado = frame i sem ACK
+    unsigned int enviados = 0;              // ja enviados alguma vez
+    unsigned int em_voo = 0;                // enviados e aguardando ACK
+    unsigned int reenviados = 0;            // retransmitidos, nao servem para medir RTT
+    long long enviado_ns[32];
+    int paridade_enviada = (k == 0);
+    int perdidos = 0;
+
+    while (pendentes)
+    {
+        // completa a janela, em ordem de sequencia, num unico lote
+        uring_lote(1);
+        for (int i = 0; i < n && __builtin_popcount(em_voo) < cc_janela(par); i++)
+        {
+            unsigned int bit = 1u << i;
+            if (!(pendentes & bit) || (em_voo & bit))
+                continue;
+            if (enviados & bit)
+            {
+                reenviados |= bit;
+                perdidos++;
+            }
+            enviado_ns[i] = envia_no_ritmo(sock, par, frames[i], dest_mac);
+            enviados |= bit;
+            em_voo |= bit;
+        }
+
+        // a paridade vai uma vez, logo depois do ultimo frame do grupo
+        if (!paridade_enviada && enviados == (1u << n) - 1)
+        {
+            for (int j = 0; j < k; j++)
+                envia_no_ritmo(sock, par, paridades[j], dest_mac);
+            paridade_enviada = 1;
+        }
+        uring_lote(0);
+
+        // espera o proximo ACK do grupo
+        int progresso = 0;
+        int espera_ms = cc_timeout_ms(par, timeout_ms);
+        long long t0 = timestamp_ms();
+        long long restante;
+        while (!progresso && (restante = espera_ms - (timestamp_ms() - t0)) > 0)
+        {
+            BufferFrame *resposta = NULL;
+            if (!espera_dados(sock, restante) || receber_buffer(sock, &resposta, NULL) != 0)
+            {
+                buffer_solta(resposta);
+                continue;
+            }
+            ouvido(par, resposta);
+            if (buffer_tipo(resposta) != 0)
+            {
+                buffer_solta(resposta);
+                continue;
+            }
+            for (int i = 0; i < n; i++)
+            {
+                unsigned int bit = 1u << i;
+                if ((pendentes & bit) && buffer_sequencia(frames[i]) == buffer_sequencia(resposta))
+                {
+                    pendentes &= ~bit;
+                    em_voo &= ~bit;
+                    progresso = 1;
+                    // ACK com dados[0] = 1: o receptor reconstruiu o frame pela paridade
+                    // (perda por ruido, nao reduz a janela)
+                    if (buffer_tamanho(resposta) > 0 && buffer_dados(resposta)[0] == 1)
+                        perdidos++;
+                    else if (!(reenviados & bit))
+                    {
+                        long long rtt = mede_rtt(sock, buffer_sequencia(frames[i]), resposta, enviado_ns[i]);
+                        if (rtt >= 0)
+                            cc_ack(par, rtt);
+                    }
+                    break;
+                }
+            }
+            buffer_solta(resposta);
+        }
+
+        if (progresso)
+        {
+            tentativas = config.tentativas;
+        }
+        else
+        {
+            // timeout: tudo o que estava em voo se perdeu
+            if (--tentativas == 0)
+            {
+                registra(REG_AVISO, "Sem resposta em %d tentativas, desistindo do grupo", config.tentativas);
+                return -1;
+            }
+            if (batimento_falhou(par))
+            {
+                registra(REG_AVISO, "Par sem sinal de vida, desistindo do grupo");
+                return -1;
+            }
+            registra(REG_AVISO, "Timeout. Reenviando frames do grupo...");
+            cc_perda(par);
+            em_voo = 0;
+        }
+    }
+    return perdidos;
+}
+
+// tenta receber um unico frame e devolve ACK/NACK
+// retorna 0 se recebeu um frame valido, -2 se chegou corrompido e -1 caso nada util tenha chegado
+int tentar_receber_com_ack(int sock, Frame *frame, uchar *mac_origem)
+{
+    BufferFrame *b;
+    int ret = tentar_receber_buffer_com_ack(sock, &b, mac_origem);
+    if (ret == 0) {
+        buffer_para_frame(b, frame);
+        buffer_solta(b);
+    }
+    return ret;
+}
+
+// frames que recebem ACK de quem os recebe
+int confirmado(uchar tipo)
+{
+    return tipo != TIPO_PARIDADE && tipo != TIPO_SONDA && tipo != TIPO_BATIMENTO;
+}
+
+// igual a tentar_receber_com_ack, entregando o proprio buffer recebido (quem chama o solta)
+int tentar_receber_buffer_com_ack(int sock, BufferFrame **saida, uchar *mac_origem)
+{
+    int ret = tentar_receber_sem_ack(sock, saida, mac_origem);
+    // envia ACK de volta (tipo 0)
+    // paridades nao sao confirmadas, o ACK iria para o primeiro frame do grupo,
+    // sondas sao respondidas pelo eco do servidor e batimentos nao pedem resposta
+    if (ret == 0 && confirmado(buffer_tipo(*saida)))
+        responder(sock, buffer_sequencia(*saida), 0, buffer_mac_origem(*saida));
+    return ret;
+}
+
+// recebe um frame e so responde o NACK; o frame valido fica para quem chamou responder
+// (ACK, ou outra resposta como TIPO_TEM)
+int tentar_receber_sem_ack(int sock, BufferFrame **saida, uchar *mac_origem)
+{
+    *saida = NULL;
+    BufferFrame *b;
+    int ret = receber_buffer(sock, &b, NULL);
+    if (ret == -1)
+        return -1;
+
+    if (ret == 0) {
+        // MAC de origem vem do cabecalho Ethernet
+        if (mac_origem) memcpy(mac_origem, buffer_mac_origem(b), 6);
+        // todo frame valido e sinal de vida de quem enviou
+        Par *par = par_busca(buffer_mac_origem(b));
+        batimento_ouvido(par, par->usado_ns);
+        *saida = b;
+    }
+    else {
+        // checksum invalido, envia NACK (tipo 1)
+        responder(sock, buffer_sequencia(b), 1, buffer_mac_origem(b));
+        buffer_solta(b);
+    }
+    return ret;
+}
+
+// envia a resposta sem payload a um frame recebido: ACK (0), NACK (1) ou TIPO_TEM
+// usa um buffer proprio, o recebido segue com quem chamou
+void responder(int sock, uchar sequencia, uchar tipo, const uchar *mac)
+{
+    BufferFrame *resposta = buffer_aloca();
+    if (!resposta)
+        return;
+    buffer_monta(resposta, sequencia, tipo, NULL, 0);
+    enviar_buffer(sock, resposta, mac);
+    buffer_solta(resposta);
+}
+
+// recebe um frame e devolve ACK/NACK
+int receber_com_ack(int sock, Frame *frame, uchar *mac_origem, int timeout_ms) {
+    BufferFrame *b;
+    int ret = receber_buffer_com_ack(sock, &b, mac_origem, timeout_ms);
+    if (ret == 0) {
+        buffer_para_frame(b, frame);
+        buffer_solta(b);
+    }
+    return ret;
+}
+
+// igual a receber_com_ack, entregando o proprio buffer recebido (quem chama o solta)
+int receber_buffer_com_ack(int sock, BufferFrame **saida, uchar *mac_origem, int timeout_ms) {
+    long long inicio = timestamp_ms();
+    long long restante;
+    while ((restante = timeout_ms - (timestamp_ms() - inicio)) > 0) {
+        if (!espera_dados(sock, restante))
+            break;
+        // frames corrompidos ja recebem NACK, entao continua aguardando novo frame
+        if (tentar_receber_buffer_com_ack(sock, saida, mac_origem) == 0)
+            return 0;
+    }
+    *saida = NULL;
+    return -1; // timeout sem receber nada valido
+}
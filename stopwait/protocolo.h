@@ -0,0 +1,93 @@
+#ifndef PROTOCOLO_H
+#define PROTOCOLO_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define MAX_DADOS 127
+#define MARCADOR_INICIO 0x7E
+#define TAMANHO_FRAME (6 + MAX_DADOS) // header + payload
+#define TAMANHO_ETH 14                // cabecalho Ethernet
+#define ETHERTYPE_CUSTOM 0x88B5       // exemplo de tipo para identificar o protocolo
+#define MAX_SOCKETS 64                // sockets com MAC de interface conhecido
+#define ERRO_SEM_PERMISSAO 0
+#define ERRO_ESPACO_INSUFICIENTE 1
+#define ERRO_RESUMO 3 // cliente -> servidor: o objeto chegou diferente, manda de novo
+#define ESPACO_SEQUENCIA 32 // sequencia tem 5 bits
+#define TIPO_PARIDADE 2     // paridade de FEC, nao e confirmada
+#define TIPO_SONDA 3        // sondagem do enlace (sessao.h), respondida com eco em vez de ACK
+#define TIPO_BATIMENTO 4    // sinal de vida do par ocioso (batimento.h), nao e confirmado
+#define TIPO_TEM 14         // resposta no lugar do ACK: o par ja tem o conteudo anunciado
+
+typedef unsigned char uchar;
+
+typedef struct {
+    uchar marcador_inicio; // 0x7E
+    uchar tamanho;         // até 127
+    uchar sequencia;       // 5 bits
+    uchar tipo;            // 4 bits
+    uchar checksum;        // XOR de tudo acima + dados
+    uchar dados[MAX_DADOS];
+} Frame;
+
+typedef struct {
+    int x;
+    int y;
+} Posicao;
+
+// frame dentro de um buffer do pool (buffer.h)
+typedef struct BufferFrame BufferFrame;
+
+long long timestamp_ms();
+long long timestamp_ns();
+
+// Funções de frame
+Frame criar_frame(uchar sequencia, uchar tipo, uchar *dados, uchar tamanho);
+void print_frame(Frame *frame);
+
+// calcula o checksum sobre os campos tamanho, sequencia, tipo e dados
+// fica no header para ser expandido em quem chama, dentro ou fora da biblioteca
+static inline uchar calcular_checksum(const Frame *frame)
+{
+    uchar chk = frame->tamanho ^ frame->sequencia ^ frame->tipo;
+    for (int i = 0; i < frame->tamanho; i++)
+        chk ^= frame->dados[i];
+    return chk;
+}
+
+// verifica se o checksum bate
+static inline int verificar_checksum(const Frame *frame)
+{
+    return calcular_checksum(frame) == frame->checksum;
+}
+
+// Funções de rede
+int serializa_frame(uchar *destino, const Frame *frame);
+int enviar_frame(int socket_fd, const Frame *frame, const uchar *dest_mac);
+int receber_frame_de(int socket_fd, Frame *frame, const uchar *filtro_mac, uchar *mac_origem);
+static inline int receber_frame(int socket_fd, Frame *frame, const uchar *filtro_mac)
+{
+    return receber_frame_de(socket_fd, frame, filtro_mac, NULL);
+}
+int enviar_buffer(int socket_fd, BufferFrame *b, const uchar *dest_mac);
+int receber_buffer(int socket_fd, BufferFrame **saida, const uchar *filtro_mac);
+int cria_raw_socket(char* nome_interface_rede);
+int espera_dados(int sock, long long timeout_ms);
+long long mede_rtt(int sock, uchar sequencia, const BufferFrame *resposta, long long enviado_ns);
+
+// Stop-and-wait: envio e recepção com controle de fluxo
+int enviar_com_ack(int sock, const Frame *frame, const uchar *dest_mac, int timeout_ms);
+int receber_com_ack(int sock, Frame *frame, uchar *mac_origem, int timeout_ms);
+int tentar_receber_com_ack(int sock, Frame *frame, uchar *mac_origem);
+
+// mesmas funcoes sobre buffers do pool, sem copiar o frame
+int enviar_buffer_com_ack(int sock, BufferFrame *b, const uchar *dest_mac, int timeout_ms);
+int receber_buffer_com_ack(int sock, BufferFrame **saida, uchar *mac_origem, int timeout_ms);
+int tentar_receber_buffer_com_ack(int sock, BufferFrame **saida, uchar *mac_origem);
+int tentar_receber_sem_ack(int sock, BufferFrame **saida, uchar *mac_origem);
+void responder(int sock, uchar sequencia, uchar tipo, const uchar *mac);
+int confirmado(uchar tipo);
+int enviar_grupo_com_ack(int sock, BufferFrame *frames[], int n, BufferFrame *paridades[], int k,
+                         const uchar *dest_mac, int timeout_ms);
+
+#endif
\ No newline at end of file
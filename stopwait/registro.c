@@ -0,0 +1,346 @@
+#include "registro.h"
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+// o que cada conversao do formato consome dos argumentos
+#define ARG_NADA 0 // %%
+#define ARG_INT 1
+#define ARG_LONG 2
+#define ARG_LLONG 3
+#define ARG_SIZE 4
+#define ARG_DOUBLE 5
+#define ARG_TEXTO 6 // copiado para o registro, o ponteiro pode nao valer mais ao formatar
+#define ARG_PONTEIRO 7
+
+#define CONVERSAO_MAX 16 // "%-08.3lld" e afins, mais longas sao formatadas na hora
+
+typedef union
+{
+    long long i; // inteiros, e o inicio do texto dos %s em 'texto'
+    double d;
+    const void *p;
+} Argumento;
+
+// o formato (literal) e os argumentos crus; a thread de fundo formata
+// sem 'formato' o texto ja vem formatado, para as conversoes que nao cabem aqui
+typedef struct
+{
+    const char *formato;
+    int nivel;
+    int n;
+    Argumento args[REGISTRO_ARGUMENTOS];
+    char texto[REGISTRO_TEXTO];
+} Registro;
+
+// anel de uma thread: ela escreve em 'escrita', a thread de fundo avanca 'leitura'
+// os indices ficam em linhas de cache separadas para os dois lados nao disputarem
+typedef struct
+{
+    _Alignas(64) atomic_uint escrita;
+    _Alignas(64) atomic_uint leitura;
+    _Alignas(64) atomic_uint perdidos;
+    Registro posicoes[REGISTRO_POSICOES];
+} Anel;
+
+int registro_nivel = REG_INFO;
+
+static Anel aneis[REGISTRO_ANEIS];
+static atomic_int usados;          // aneis ja entregues a alguma thread
+static _Thread_local Anel *proprio; // anel da thread atual
+static _Thread_local int sem_anel;  // a thread chegou depois dos REGISTRO_ANEIS, escreve direto
+static atomic_int rodando;
+static pthread_t fundo;
+
+static const char *nomes[] = {"erro", "aviso", "info", "depura"};
+
+int registro_nivel_por_nome(const char *nome)
+{
+    for (int n = REG_ERRO; n <= REG_DEPURA; n++)
+        if (strcmp(nome, nomes[n]) == 0)
+            return n;
+    return -1;
+}
+
+// le a conversao depois de um '%': flags, largura, precisao, tamanho e a letra
+// retorna o numero de caracteres dela, com o ARG_* em 'tipo', ou 0 se nao e suportada ('*', %n, %Lf...)
+static int conversao(const char *f, int *tipo)
+{
+    const char *c = f + strspn(f, "-+ #0");
+    c += strspn(c, "0123456789");
+    if (*c == '.')
+        c += 1 + strspn(c + 1, "0123456789");
+    int tamanho = 0; // 1 l, 2 ll, 3 z
+    if (*c == 'h')
+        c += c[1] == 'h' ? 2 : 1; // promovidos a int
+    else if (*c == 'l')
+        c += (tamanho = c[1] == 'l' ? 2 : 1);
+    else if (*c == 'z')
+        c += (tamanho = 3);
+
+    switch (*c)
+    {
+    case '%':
+        if (c != f)
+            return 0;
+        *tipo = ARG_NADA;
+        break;
+    case 'd':
+    case 'i':
+    case 'u':
+    case 'o':
+    case 'x':
+    case 'X':
+        *tipo = (int[]){ARG_INT, ARG_LONG, ARG_LLONG, ARG_SIZE}[tamanho];
+        break;
+    case 'c':
+        if (tamanho)
+            return 0;
+        *tipo = ARG_INT;
+        break;
+    case 'f':
+    case 'F':
+    case 'e':
+    case 'E':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A':
+        if (tamanho > 1)
+            return 0;
+        *tipo = ARG_DOUBLE;
+        break;
+    case 's':
+        if (tamanho)
+            return 0;
+        *tipo = ARG_TEXTO;
+        break;
+    case 'p':
+        *tipo = ARG_PONTEIRO;
+        break;
+    default:
+        return 0;
+    }
+    int n = c + 1 - f;
+    return n < CONVERSAO_MAX ? n : 0;
+}
+
+// guarda os argumentos crus no registro, so copiando as strings
+// retorna -1 se o formato tem algo que nao da para guardar assim
+static int guarda(Registro *r, const char *formato, va_list args)
+{
+    int n = 0, usado = 0;
+    for (const char *f = formato; (f = strchr(f, '%')) != NULL;)
+    {
+        int tipo, t = conversao(f + 1, &tipo);
+        if (!t || (tipo != ARG_NADA && n == REGISTRO_ARGUMENTOS))
+            return -1;
+        f += 1 + t;
+        switch (tipo)
+        {
+        case ARG_NADA:
+            continue;
+        case ARG_INT:
+            r->args[n].i = va_arg(args, int);
+            break;
+        case ARG_LONG:
+            r->args[n].i = va_arg(args, long);
+            break;
+        case ARG_LLONG:
+            r->args[n].i = va_arg(args, long long);
+            break;
+        case ARG_SIZE:
+            r->args[n].i = (long long)va_arg(args, size_t);
+            break;
+        case ARG_DOUBLE:
+            r->args[n].d = va_arg(args, double);
+            break;
+        case ARG_PONTEIRO:
+            r->args[n].p = va_arg(args, void *);
+            break;
+        case ARG_TEXTO:
+        {
+            // o que nao cabe e cortado; depois de cheio, o ultimo '\0' serve a todas as seguintes
+            const char *texto = va_arg(args, const char *);
+            if (!texto)
+                texto = "(null)";
+            size_t tamanho = strnlen(texto, sizeof(r->texto) - 1 - usado);
+            memcpy(r->texto + usado, texto, tamanho);
+            r->texto[usado + tamanho] = '\0';
+            r->args[n].i = usado;
+            usado += tamanho + (usado + tamanho < sizeof(r->texto) - 1);
+            break;
+        }
+        }
+        n++;
+    }
+    r->formato = formato;
+    r->n = n;
+    return 0;
+}
+
+// formata um registro na thread de fundo, conversao por conversao
+static void escreve(const Registro *r)
+{
+    FILE *saida = r->nivel == REG_ERRO ? stderr : stdout;
+    if (!r->formato)
+    {
+        fputs(r->texto, saida);
+        fputc('\n', saida);
+        return;
+    }
+
+    const char *f = r->formato;
+    const Argumento *a = r->args;
+    const char *p;
+    while ((p = strchr(f, '%')) != NULL)
+    {
+        fwrite(f, 1, p - f, saida);
+        int tipo, t = conversao(p + 1, &tipo);
+        char spec[CONVERSAO_MAX + 1];
+        memcpy(spec, p, t + 1);
+        spec[t + 1] = '\0';
+        switch (tipo)
+        {
+        case ARG_NADA:
+            fputc('%', saida);
+            break;
+        case ARG_INT:
+            fprintf(saida, spec, (int)a++->i);
+            break;
+        case ARG_LONG:
+            fprintf(saida, spec, (long)a++->i);
+            break;
+        case ARG_LLONG:
+            fprintf(saida, spec, a++->i);
+            break;
+        case ARG_SIZE:
+            fprintf(saida, spec, (size_t)a++->i);
+            break;
+        case ARG_DOUBLE:
+            fprintf(saida, spec, a++->d);
+            break;
+        case ARG_PONTEIRO:
+            fprintf(saida, spec, a++->p);
+            break;
+        case ARG_TEXTO:
+            fprintf(saida, spec, r->texto + a++->i);
+            break;
+        }
+        f = p + 1 + t;
+    }
+    fputs(f, saida);
+    fputc('\n', saida);
+}
+
+// esvazia os aneis no terminal; retorna quantos registros escreveu
+static int descarrega(void)
+{
+    int escritos = 0;
+    int n = atomic_load_explicit(&usados, memory_order_acquire);
+    for (int a = 0; a < n && a < REGISTRO_ANEIS; a++)
+    {
+        Anel *anel = &aneis[a];
+        unsigned leitura = atomic_load_explicit(&anel->leitura, memory_order_relaxed);
+        unsigned escrita = atomic_load_explicit(&anel->escrita, memory_order_acquire);
+        for (; leitura != escrita; leitura++, escritos++)
+        {
+            escreve(&anel->posicoes[leitura % REGISTRO_POSICOES]);
+        }
+        atomic_store_explicit(&anel->leitura, leitura, memory_order_release);
+
+        unsigned perdidos = atomic_exchange_explicit(&anel->perdidos, 0, memory_order_relaxed);
+        if (perdidos)
+            fprintf(stderr, "(%u registros perdidos com o anel cheio)\n", perdidos);
+    }
+    if (escritos)
+        fflush(stdout); // os erros ja saem direto pelo stderr
+    return escritos;
+}
+
+static void *thread_fundo(void *arg)
+{
+    (void)arg;
+    while (atomic_load_explicit(&rodando, memory_order_acquire))
+    {
+        if (!descarrega())
+            usleep(REGISTRO_ESPERA_US);
+    }
+    descarrega();
+    return NULL;
+}
+
+// sobe a thread de fundo; sem ela os registros saem direto no terminal
+int registro_inicia(int nivel)
+{
+    registro_nivel = nivel;
+    if (atomic_load(&rodando))
+        return 0;
+    atomic_store(&rodando, 1);
+    if (pthread_create(&fundo, NULL, thread_fundo, NULL) != 0)
+    {
+        atomic_store(&rodando, 0);
+        return -1;
+    }
+    return 0;
+}
+
+// escreve o que ficou nos aneis e para a thread
+void registro_termina(void)
+{
+    if (!atomic_exchange(&rodando, 0))
+        return;
+    pthread_join(fundo, NULL);
+}
+
+void registro_grava(int nivel, const char *formato, ...)
+{
+    va_list args;
+    va_start(args, formato);
+    int ligado = atomic_load_explicit(&rodando, memory_order_relaxed);
+
+    // o primeiro registro da thread pega um anel so para ela
+    if (ligado && !proprio && !sem_anel)
+    {
+        int a = atomic_fetch_add(&usados, 1);
+        if (a < REGISTRO_ANEIS)
+            proprio = &aneis[a];
+        else
+            sem_anel = 1;
+    }
+    // sem a thread de fundo, ou sem anel livre, escreve direto
+    if (!ligado || !proprio)
+    {
+        FILE *saida = nivel == REG_ERRO ? stderr : stdout;
+        vfprintf(saida, formato, args);
+        fputc('\n', saida);
+        va_end(args);
+        return;
+    }
+
+    unsigned escrita = atomic_load_explicit(&proprio->escrita, memory_order_relaxed);
+    unsigned leitura = atomic_load_explicit(&proprio->leitura, memory_order_acquire);
+    if (escrita - leitura == REGISTRO_POSICOES)
+    {
+        atomic_fetch_add_explicit(&proprio->perdidos, 1, memory_order_relaxed);
+        va_end(args);
+        return;
+    }
+
+    // so copia; o que guarda nao entende e formatado aqui mesmo
+    Registro *r = &proprio->posicoes[escrita % REGISTRO_POSICOES];
+    va_list copia;
+    va_copy(copia, args);
+    if (guarda(r, formato, copia) != 0)
+    {
+        r->formato = NULL;
+        vsnprintf(r->texto, sizeof(r->texto), formato, args);
+    }
+    va_end(copia);
+    va_end(args);
+    r->nivel = nivel;
+    atomic_store_explicit(&proprio->escrita, escrita + 1, memory_order_release);
+}
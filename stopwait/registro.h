@@ -0,0 +1,49 @@
+#ifndef REGISTRO_H
+#define REGISTRO_H
+
+// registro de mensagens fora do caminho dos frames: quem registra so copia o formato e os
+// argumentos num anel em memoria, e uma thread de fundo formata e escreve no terminal
+// o formato tem que ser literal; as strings dos %s sao copiadas
+// cada thread tem o seu anel (um produtor e um consumidor, sem trava); anel cheio perde
+// o registro em vez de esperar, e a perda e contada
+// make REGISTRO=0 tira todas as chamadas na compilacao
+
+#ifndef REGISTRO_ATIVO
+#define REGISTRO_ATIVO 1
+#endif
+
+#define REG_ERRO 0
+#define REG_AVISO 1
+#define REG_INFO 2
+#define REG_DEPURA 3
+
+#define REGISTRO_ANEIS 4       // threads que registram
+#define REGISTRO_POSICOES 256  // registros por anel, potencia de 2
+#define REGISTRO_ARGUMENTOS 8  // argumentos de um registro, com mais ele e formatado na hora
+#define REGISTRO_TEXTO 96      // strings dos %s de um registro, o resto e cortado
+#define REGISTRO_ESPERA_US 2000 // a thread de fundo dorme isso com os aneis vazios
+
+extern int registro_nivel; // registros acima deste nivel sao ignorados
+
+#if REGISTRO_ATIVO
+#define registra(nivel, ...)                          \
+    do                                                \
+    {                                                 \
+        if ((nivel) <= registro_nivel)                \
+            registro_grava((nivel), __VA_ARGS__);     \
+    } while (0)
+#else
+#define registra(nivel, ...)                          \
+    do                                                \
+    {                                                 \
+        if (0)                                        \
+            registro_grava((nivel), __VA_ARGS__);     \
+    } while (0)
+#endif
+
+int registro_inicia(int nivel);
+void registro_termina(void);
+void registro_grava(int nivel, const char *formato, ...) __attribute__((format(printf, 2, 3)));
+int registro_nivel_por_nome(const char *nome);
+
+#endif
@@ -0,0 +1,251 @@
+#include "resumo.h"
+#include <stdio.h>
+#include <string.h>
+
+// XXH64: quatro acumuladores sobre blocos de 32 bytes
+#define XXH_P1 0x9E3779B185EBCA87ULL
+#define XXH_P2 0xC2B2AE3D27D4EB4FULL
+#define XXH_P3 0x165667B19E3779F9ULL
+#define XXH_P4 0x85EBCA77C2B2AE63ULL
+#define XXH_P5 0x27D4EB2F165667C5ULL
+#define XXH_BLOCO 32
+#define SHA_BLOCO 64
+
+static uint64_t rotl64(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+static uint32_t rotr32(uint32_t x, int r) { return (x >> r) | (x << (32 - r)); }
+
+// leituras em little endian sem depender do alinhamento
+static uint64_t le64(const uchar *p)
+{
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+static uint32_t le32(const uchar *p)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static uint64_t xxh_rodada(uint64_t acc, uint64_t entrada)
+{
+    acc += entrada * XXH_P2;
+    acc = rotl64(acc, 31);
+    return acc * XXH_P1;
+}
+
+static uint64_t xxh_junta(uint64_t acc, uint64_t v)
+{
+    acc ^= xxh_rodada(0, v);
+    return acc * XXH_P1 + XXH_P4;
+}
+
+static void xxh_bloco(Resumo *r, const uchar *p)
+{
+    for (int i = 0; i < 4; i++)
+        r->estado.xxh[i] = xxh_rodada(r->estado.xxh[i], le64(p + 8 * i));
+}
+
+static uint64_t xxh_final(Resumo *r)
+{
+    uint64_t *v = r->estado.xxh;
+    uint64_t h;
+    if (r->total >= XXH_BLOCO)
+    {
+        h = rotl64(v[0], 1) + rotl64(v[1], 7) + rotl64(v[2], 12) + rotl64(v[3], 18);
+        for (int i = 0; i < 4; i++)
+            h = xxh_junta(h, v[i]);
+    }
+    else
+    {
+        h = v[2] + XXH_P5; // semente 0
+    }
+    h += r->total;
+
+    // o resto que nao completou um bloco
+    const uchar *p = r->pendente;
+    int n = r->usado;
+    for (; n >= 8; p += 8, n -= 8)
+        h = rotl64(h ^ xxh_rodada(0, le64(p)), 27) * XXH_P1 + XXH_P4;
+    if (n >= 4)
+    {
+        h = rotl64(h ^ (uint64_t)le32(p) * XXH_P1, 23) * XXH_P2 + XXH_P3;
+        p += 4;
+        n -= 4;
+    }
+    for (; n > 0; p++, n--)
+        h = rotl64(h ^ *p * XXH_P5, 11) * XXH_P1;
+
+    h ^= h >> 33;
+    h *= XXH_P2;
+    h ^= h >> 29;
+    h *= XXH_P3;
+    h ^= h >> 32;
+    return h;
+}
+
+// SHA-256 (FIPS 180-4)
+static const uint32_t sha_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+static void sha_bloco(Resumo *r, const uchar *p)
+{
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++)
+        w[i] = (uint32_t)p[4 * i] << 24 | (uint32_t)p[4 * i + 1] << 16 | (uint32_t)p[4 * i + 2] << 8 | p[4 * i + 3];
+    for (int i = 16; i < 64; i++)
+    {
+        uint32_t s0 = rotr32(w[i - 15], 7) ^ rotr32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = rotr32(w[i - 2], 17) ^ rotr32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t v[8];
+    memcpy(v, r->estado.sha, sizeof(v));
+    for (int i = 0; i < 64; i++)
+    {
+        uint32_t s1 = rotr32(v[4], 6) ^ rotr32(v[4], 11) ^ rotr32(v[4], 25);
+        uint32_t ch = (v[4] & v[5]) ^ (~v[4] & v[6]);
+        uint32_t t1 = v[7] + s1 + ch + sha_k[i] + w[i];
+        uint32_t s0 = rotr32(v[0], 2) ^ rotr32(v[0], 13) ^ rotr32(v[0], 22);
+        uint32_t maj = (v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]);
+        memmove(v + 1, v, 7 * sizeof(uint32_t));
+        v[4] += t1;
+        v[0] = t1 + s0 + maj;
+    }
+    for (int i = 0; i < 8; i++)
+        r->estado.sha[i] += v[i];
+}
+
+static void sha_final(Resumo *r, uchar *saida)
+{
+    uint64_t bits = r->total * 8;
+    uchar fim[SHA_BLOCO * 2] = {0x80};
+    int preenche = (r->usado < 56 ? 56 : 120) - r->usado;
+    for (int i = 0; i < 8; i++)
+        fim[preenche + i] = bits >> (56 - 8 * i);
+    // o tamanho total nao entra na conta
+    uint64_t total = r->total;
+    resumo_atualiza(r, fim, preenche + 8);
+    r->total = total;
+    for (int i = 0; i < 8; i++)
+        for (int j = 0; j < 4; j++)
+            saida[4 * i + j] = r->estado.sha[i] >> (24 - 8 * j);
+}
+
+static int tamanho_bloco(int algoritmo)
+{
+    return algoritmo == RESUMO_SHA256 ? SHA_BLOCO : XXH_BLOCO;
+}
+
+void resumo_inicia(Resumo *r, int algoritmo)
+{
+    static const uint32_t sha_inicial[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                                            0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    memset(r, 0, sizeof(*r));
+    r->algoritmo = algoritmo;
+    if (algoritmo == RESUMO_SHA256)
+    {
+        memcpy(r->estado.sha, sha_inicial, sizeof(sha_inicial));
+    }
+    else if (algoritmo == RESUMO_XXH64)
+    {
+        r->estado.xxh[0] = XXH_P1 + XXH_P2;
+        r->estado.xxh[1] = XXH_P2;
+        r->estado.xxh[2] = 0;
+        r->estado.xxh[3] = -XXH_P1;
+    }
+}
+
+// acumula os bytes em blocos; pedacos de qualquer tamanho, na ordem do arquivo
+void resumo_atualiza(Resumo *r, const void *dados, size_t tamanho)
+{
+    if (r->algoritmo == RESUMO_NENHUM)
+        return;
+    const uchar *p = dados;
+    int bloco = tamanho_bloco(r->algoritmo);
+    r->total += tamanho;
+
+    // completa o bloco pendente
+    if (r->usado)
+    {
+        size_t falta = bloco - r->usado;
+        size_t n = tamanho < falta ? tamanho : falta;
+        memcpy(r->pendente + r->usado, p, n);
+        r->usado += n;
+        p += n;
+        tamanho -= n;
+        if (r->usado < bloco)
+            return;
+        if (r->algoritmo == RESUMO_SHA256)
+            sha_bloco(r, r->pendente);
+        else
+            xxh_bloco(r, r->pendente);
+        r->usado = 0;
+    }
+
+    // blocos inteiros direto da entrada
+    for (; tamanho >= (size_t)bloco; p += bloco, tamanho -= bloco)
+    {
+        if (r->algoritmo == RESUMO_SHA256)
+            sha_bloco(r, p);
+        else
+            xxh_bloco(r, p);
+    }
+    memcpy(r->pendente, p, tamanho);
+    r->usado = tamanho;
+}
+
+// escreve o resumo em 'saida' (big endian), retorna o tamanho
+int resumo_final(Resumo *r, uchar *saida)
+{
+    if (r->algoritmo == RESUMO_SHA256)
+    {
+        sha_final(r, saida);
+        return 32;
+    }
+    if (r->algoritmo == RESUMO_XXH64)
+    {
+        uint64_t h = xxh_final(r);
+        for (int i = 0; i < 8; i++)
+            saida[i] = h >> (56 - 8 * i);
+        return 8;
+    }
+    return 0;
+}
+
+int resumo_tamanho(int algoritmo)
+{
+    return algoritmo == RESUMO_SHA256 ? 32 : (algoritmo == RESUMO_XXH64 ? 8 : 0);
+}
+
+const char *resumo_nome(int algoritmo)
+{
+    return algoritmo == RESUMO_SHA256 ? "sha256" : (algoritmo == RESUMO_XXH64 ? "xxh64" : "nenhum");
+}
+
+// resumo de um arquivo inteiro do disco, o mesmo que sairia passando ele em pedacos pela rede
+int resumo_arquivo(const char *caminho, int algoritmo, uchar *saida)
+{
+    FILE *f = fopen(caminho, "rb");
+    if (!f)
+        return -1;
+    Resumo r;
+    resumo_inicia(&r, algoritmo);
+    uchar bloco[65536];
+    size_t n;
+    while ((n = fread(bloco, 1, sizeof(bloco), f)) > 0)
+        resumo_atualiza(&r, bloco, n);
+    int erro = ferror(f);
+    fclose(f);
+    return erro ? -1 : resumo_final(&r, saida);
+}
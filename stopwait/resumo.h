@@ -0,0 +1,33 @@
+#ifndef RESUMO_H
+#define RESUMO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "protocolo.h"
+
+// resumo do objeto inteiro, calculado em pedacos enquanto ele passa pela rede
+// vai no frame de fim (tipo 9) como {algoritmo, resumo}
+#define RESUMO_NENHUM 0
+#define RESUMO_XXH64 1  // rapido, nao criptografico
+#define RESUMO_SHA256 2 // criptografico, bem mais lento
+#define RESUMO_MAX 32   // bytes do maior resumo
+
+typedef struct {
+    int algoritmo;
+    uint64_t total;    // bytes vistos
+    uchar pendente[64]; // resto que ainda nao completa um bloco
+    int usado;
+    union {
+        uint64_t xxh[4];
+        uint32_t sha[8];
+    } estado;
+} Resumo;
+
+void resumo_inicia(Resumo *r, int algoritmo);
+void resumo_atualiza(Resumo *r, const void *dados, size_t tamanho);
+int resumo_final(Resumo *r, uchar *saida); // retorna quantos bytes escreveu
+int resumo_tamanho(int algoritmo);
+const char *resumo_nome(int algoritmo);
+int resumo_arquivo(const char *caminho, int algoritmo, uchar *saida); // -1 se nao abriu
+
+#endif
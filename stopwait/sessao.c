@@ -0,0 +1,234 @@
+#include "sessao.h"
+#include "buffer.h"
+#include "congestionamento.h"
+#include "mapa.h"
+#include "registro.h"
+#include <string.h>
+#include <math.h>
+
+// amostras da sondagem
+typedef struct {
+    uchar seq;
+    int enviadas;       // so dos lotes aceitos, para a perda
+    int perdidas;
+    long long srtt_ns;  // RTT suavizado e variacao, como no RFC 6298
+    long long rttvar_ns;
+} Medida;
+
+static void amostra_rtt(Medida *m, long long rtt_ns)
+{
+    if (m->srtt_ns == 0)
+    {
+        m->srtt_ns = rtt_ns;
+        m->rttvar_ns = rtt_ns / 2;
+        return;
+    }
+    long long desvio = m->srtt_ns > rtt_ns ? m->srtt_ns - rtt_ns : rtt_ns - m->srtt_ns;
+    m->rttvar_ns = (3 * m->rttvar_ns + desvio) / 4;
+    m->srtt_ns = (7 * m->srtt_ns + rtt_ns) / 8;
+}
+
+// envia um frame de sondagem de 'tamanho' bytes e espera o eco, aprendendo o MAC do servidor
+// o payload do eco fica em 'eco_dados', se dado
+// retorna o RTT em ns, ou -1 se o eco nao voltou a tempo
+static long long ida_e_volta(int sock, uchar *mac_servidor, uchar seq, const uchar *carga, int tamanho,
+                             uchar *eco_dados)
+{
+    BufferFrame *b = buffer_aloca();
+    if (!b)
+        return -1;
+    buffer_monta(b, seq, TIPO_SONDA, carga, tamanho);
+    long long t0 = timestamp_ns();
+    enviar_buffer(sock, b, mac_servidor);
+    buffer_solta(b);
+
+    long long restante;
+    while ((restante = SONDA_ESPERA_MS - (timestamp_ns() - t0) / 1000000) > 0)
+    {
+        BufferFrame *eco = NULL;
+        if (!espera_dados(sock, restante) || receber_buffer(sock, &eco, NULL) != 0)
+        {
+            buffer_solta(eco);
+            continue;
+        }
+        // o eco tem que voltar inteiro, e o tamanho que mede o caminho
+        int ok = buffer_tipo(eco) == TIPO_SONDA && buffer_sequencia(eco) == seq &&
+                 buffer_tamanho(eco) == tamanho && buffer_dados(eco)[0] == (carga[0] | SONDA_RESPOSTA);
+        long long rtt = ok ? mede_rtt(sock, seq, eco, t0) : -1;
+        if (rtt >= 0)
+        {
+            memcpy(mac_servidor, buffer_mac_origem(eco), 6);
+            if (eco_dados)
+                memcpy(eco_dados, buffer_dados(eco), tamanho);
+        }
+        buffer_solta(eco);
+        if (rtt >= 0)
+            return rtt;
+    }
+    return -1;
+}
+
+// um lote de sondas de 'tamanho' bytes, retorna quantas voltaram
+static int sonda_lote(int sock, uchar *mac_servidor, int tamanho, Medida *m)
+{
+    uchar carga[MAX_DADOS];
+    carga[0] = SONDA_PEDIDO;
+    for (int i = 1; i < tamanho; i++)
+        carga[i] = (uchar)i;
+
+    int voltaram = 0;
+    for (int i = 0; i < SONDAS_POR_TAMANHO; i++)
+    {
+        m->seq = (m->seq + 1) % ESPACO_SEQUENCIA;
+        long long rtt = ida_e_volta(sock, mac_servidor, m->seq, carga, tamanho, NULL);
+        if (rtt >= 0)
+        {
+            amostra_rtt(m, rtt);
+            voltaram++;
+        }
+    }
+    return voltaram;
+}
+
+static int limita(int v, int minimo, int maximo)
+{
+    return v < minimo ? minimo : (v > maximo ? maximo : v);
+}
+
+// o valor que o servidor confirmou no eco do acordo, se ele fixou outro
+static void adota(const char *nome, int *campo, int valor)
+{
+    if (*campo == valor)
+        return;
+    registra(REG_AVISO, "Servidor usa %s %d, no lugar de %d", nome, valor, *campo);
+    *campo = valor;
+}
+
+// cliente: sonda o enlace, escolhe os parametros que o usuario nao fixou e os combina com o servidor
+// retorna 0 se o servidor confirmou, -1 se nao respondeu (c fica com o que foi possivel medir)
+int sessao_negocia(int sock, uchar *mac_servidor, Config *c)
+{
+    Medida m = {0};
+
+    // o menor tamanho primeiro: diz se ha servidor e da a base de RTT e perda
+    int voltaram = sonda_lote(sock, mac_servidor, SONDA_MINIMA, &m);
+    if (voltaram == 0)
+        return -1;
+    m.enviadas += SONDAS_POR_TAMANHO;
+    m.perdidas += SONDAS_POR_TAMANHO - voltaram;
+
+    // maior payload que atravessa o caminho: frames grandes demais somem todos,
+    // perda comum leva so alguns, entao basta a maioria voltar
+    int tamanho = SONDA_MINIMA;
+    static const int tamanhos[] = {MAX_DADOS, 96, 64};
+    for (size_t i = 0; i < sizeof(tamanhos) / sizeof(tamanhos[0]); i++)
+    {
+        int t = (c->fixos & CFG_TAMANHO) ? c->tamanho_dados : tamanhos[i];
+        voltaram = sonda_lote(sock, mac_servidor, t, &m);
+        if (2 * voltaram > SONDAS_POR_TAMANHO)
+        {
+            tamanho = t;
+            m.enviadas += SONDAS_POR_TAMANHO;
+            m.perdidas += SONDAS_POR_TAMANHO - voltaram;
+            break;
+        }
+        if (c->fixos & CFG_TAMANHO)
+            break;
+    }
+    double perda = (double)m.perdidas / m.enviadas;
+
+    if (!(c->fixos & CFG_TAMANHO))
+        c->tamanho_dados = tamanho;
+    // timeout pelo RTO medido, com folga para o processamento do outro lado
+    if (!(c->fixos & CFG_TIMEOUT))
+        c->timeout_ms = limita((int)ceil(FOLGA_TIMEOUT * (m.srtt_ns + 4 * m.rttvar_ns) / 1e6),
+                               TIMEOUT_MINIMO, TIMEOUT_PADRAO);
+    // tentativas para um frame quase nunca esgotar todas: perda^tentativas < PERDA_ALVO
+    if (!(c->fixos & CFG_TENTATIVAS))
+        c->tentativas = perda > 0 ? limita((int)ceil(log(PERDA_ALVO) / log(perda)),
+                                           TENTATIVAS_PADRAO, TENTATIVAS_MAX)
+                                  : TENTATIVAS_PADRAO;
+    // janela que a perda sustenta (Mathis: ~1.22 / sqrt(perda))
+    if (!(c->fixos & CFG_JANELA))
+        c->janela = perda > 0 ? limita((int)(1.22 / sqrt(perda)), 1, JANELA_MAX) : JANELA_MAX;
+
+    // o servidor passa a usar os mesmos valores, menos os que o usuario dele fixou; o eco
+    // confirma o acordo com os valores que ele vai de fato usar, e o cliente adota esses
+    uchar acordo[ACORDO_TAMANHO] = {SONDA_ACORDO, c->tamanho_dados, c->janela, c->tentativas,
+                                    c->timeout_ms >> 8, c->timeout_ms & 0xFF,
+                                    c->largura >> 8, c->largura & 0xFF, c->altura >> 8, c->altura & 0xFF};
+    uchar eco[ACORDO_TAMANHO];
+    for (int i = 0; i < c->tentativas; i++)
+    {
+        m.seq = (m.seq + 1) % ESPACO_SEQUENCIA;
+        if (ida_e_volta(sock, mac_servidor, m.seq, acordo, sizeof(acordo), eco) < 0)
+            continue;
+        int timeout = (eco[4] << 8) | eco[5];
+        if (eco[1] >= TAMANHO_MINIMO && eco[1] <= MAX_DADOS)
+            adota("payload", &c->tamanho_dados, eco[1]);
+        if (eco[2] >= 1 && eco[2] <= JANELA_MAX)
+            adota("janela", &c->janela, eco[2]);
+        if (eco[3] >= 1)
+            adota("tentativas", &c->tentativas, eco[3]);
+        if (timeout >= 1)
+            adota("timeout_ms", &c->timeout_ms, timeout);
+        int largura = (eco[6] << 8) | eco[7];
+        int altura = (eco[8] << 8) | eco[9];
+        if (largura >= 1 && largura <= LADO_MAX && altura >= 1 && altura <= LADO_MAX &&
+            (largura != c->largura || altura != c->altura))
+        {
+            registra(REG_AVISO, "Mapa do servidor e %dx%d, no lugar de %dx%d", largura, altura, c->largura,
+                     c->altura);
+            c->largura = largura;
+            c->altura = altura;
+        }
+        return 0;
+    }
+    return -1;
+}
+
+// servidor: devolve a sonda como eco do mesmo tamanho (no lugar do ACK)
+// um acordo passa a valer para os campos que o usuario do servidor nao fixou,
+// e o eco dele leva os valores que o servidor vai usar, com as dimensoes do mapa
+// retorna 1 se aplicou um acordo
+int sessao_responde(int sock, const Frame *sonda, const uchar *mac_cliente, Config *c)
+{
+    if (sonda->tipo != TIPO_SONDA || sonda->tamanho < 1 || (sonda->dados[0] & SONDA_RESPOSTA))
+        return 0;
+
+    int aplicou = 0;
+    const uchar *d = sonda->dados;
+    int timeout = (d[4] << 8) | d[5];
+    if (d[0] == SONDA_ACORDO && sonda->tamanho >= 6 &&
+        d[1] >= TAMANHO_MINIMO && d[1] <= MAX_DADOS && d[2] >= 1 && d[2] <= JANELA_MAX &&
+        d[3] >= 1 && timeout >= 1)
+    {
+        if (!(c->fixos & CFG_TAMANHO))
+            c->tamanho_dados = d[1];
+        if (!(c->fixos & CFG_JANELA))
+            c->janela = d[2];
+        if (!(c->fixos & CFG_TENTATIVAS))
+            c->tentativas = d[3];
+        if (!(c->fixos & CFG_TIMEOUT))
+            c->timeout_ms = timeout;
+        aplicou = 1;
+    }
+
+    Frame eco = *sonda;
+    eco.dados[0] |= SONDA_RESPOSTA;
+    if (aplicou && sonda->tamanho >= ACORDO_TAMANHO)
+    {
+        eco.dados[1] = c->tamanho_dados;
+        eco.dados[2] = c->janela;
+        eco.dados[3] = c->tentativas;
+        eco.dados[4] = c->timeout_ms >> 8;
+        eco.dados[5] = c->timeout_ms & 0xFF;
+        eco.dados[6] = c->largura >> 8;
+        eco.dados[7] = c->largura & 0xFF;
+        eco.dados[8] = c->altura >> 8;
+        eco.dados[9] = c->altura & 0xFF;
+    }
+    eco.checksum = calcular_checksum(&eco);
+    enviar_frame(sock, &eco, mac_cliente);
+    return aplicou;
+}
@@ -0,0 +1,22 @@
+#ifndef SESSAO_H
+#define SESSAO_H
+
+#include "protocolo.h"
+#include "config.h"
+
+// payload[0] dos frames TIPO_SONDA
+#define SONDA_PEDIDO 0      // cliente -> servidor, volta como eco do mesmo tamanho
+#define SONDA_ACORDO 1      // cliente -> servidor com os parametros escolhidos
+#define SONDA_RESPOSTA 0x80 // marcado pelo servidor no eco
+#define ACORDO_TAMANHO 10   // tipo, payload, janela, tentativas, timeout (2), largura (2), altura (2)
+
+#define SONDAS_POR_TAMANHO 8 // ida e volta, uma por vez
+#define SONDA_ESPERA_MS 150  // espera por cada eco
+#define SONDA_MINIMA 32      // menor payload sondado, sondado primeiro para ver se ha servidor
+#define TENTATIVAS_MAX 20
+#define PERDA_ALVO 1e-6      // chance aceitavel de um frame esgotar as tentativas
+
+int sessao_negocia(int sock, uchar *mac_servidor, Config *c);
+int sessao_responde(int sock, const Frame *sonda, const uchar *mac_cliente, Config *c);
+
+#endif
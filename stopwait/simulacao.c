@@ -0,0 +1,434 @@
+#include "simulacao.h"
+#include "sorteio.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ucontext.h>
+
+#define EVENTO_ACORDA 0  // prazo de um no que dorme ou espera
+#define EVENTO_ENTREGA 1 // frame chegando num socket
+
+// frame a caminho ou na fila de recepcao de um socket
+typedef struct Pacote
+{
+    struct Pacote *proximo;
+    int tamanho;
+    uchar dados[TAMANHO_BUFFER];
+} Pacote;
+
+typedef struct
+{
+    long long tempo;
+    unsigned long long ordem; // no mesmo instante, na ordem em que foram agendados
+    int tipo;
+    int alvo;         // no (acorda) ou socket (entrega)
+    unsigned geracao; // acorda: so vale se o no nao foi acordado por outro motivo antes
+    Pacote *pacote;
+} Evento;
+
+// os nos nao mudam de lugar: o contexto salvo aponta para dentro de si mesmo
+typedef struct
+{
+    ucontext_t contexto;
+    void *pilha;
+    void (*corpo)(void *);
+    void *arg;
+    int vivo;
+    int esperando; // socket cujo frame acorda o no, -1 se nenhum
+    unsigned geracao;
+} No;
+
+typedef struct
+{
+    int no;
+    uchar mac[6];
+    int par; // socket do outro lado, -1 se desligado
+    SimEnlace saida;
+    long long livre_ns;   // fim da transmissao do frame anterior
+    long long chegada_ns; // ultima chegada agendada no par
+    Pacote *fila, *fim;
+} Socket;
+
+static struct
+{
+    uint64_t semente;
+    long long agora;
+    unsigned long long ordem;
+    Evento *eventos;
+    int n_eventos, cap_eventos;
+    No **nos;
+    int n_nos, cap_nos;
+    int atual; // no rodando, -1 no escalonador
+    int vivos;
+    Socket *sockets;
+    int n_sockets, cap_sockets;
+    Pacote *livres;
+    ucontext_t principal;
+    uint64_t rastro;
+    SimContagem contagem;
+} sim = {.atual = -1};
+
+#if SIMULACAO_ATIVA
+int sim_rodando;
+#endif
+
+// a simulacao nao tem como seguir sem memoria
+static void *cresce(void *v, int *cap, size_t tamanho)
+{
+    int novo = *cap ? *cap * 2 : 64;
+    v = realloc(v, novo * tamanho);
+    if (!v)
+    {
+        fprintf(stderr, "Simulacao sem memoria\n");
+        exit(1);
+    }
+    *cap = novo;
+    return v;
+}
+
+static Socket *soquete(int sock)
+{
+    return &sim.sockets[sock - SIM_SOCKET_BASE];
+}
+
+static int antes(const Evento *a, const Evento *b)
+{
+    return a->tempo < b->tempo || (a->tempo == b->tempo && a->ordem < b->ordem);
+}
+
+// fila de eventos num heap binario pelo instante
+static void agenda(int tipo, long long tempo, int alvo, unsigned geracao, Pacote *p)
+{
+    if (sim.n_eventos == sim.cap_eventos)
+        sim.eventos = cresce(sim.eventos, &sim.cap_eventos, sizeof(Evento));
+    Evento e = {tempo, sim.ordem++, tipo, alvo, geracao, p};
+    int i = sim.n_eventos++;
+    while (i > 0 && antes(&e, &sim.eventos[(i - 1) / 2]))
+    {
+        sim.eventos[i] = sim.eventos[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    sim.eventos[i] = e;
+}
+
+static Evento retira(void)
+{
+    Evento topo = sim.eventos[0];
+    Evento ultimo = sim.eventos[--sim.n_eventos];
+    int i = 0;
+    for (;;)
+    {
+        int f = 2 * i + 1;
+        if (f >= sim.n_eventos)
+            break;
+        if (f + 1 < sim.n_eventos && antes(&sim.eventos[f + 1], &sim.eventos[f]))
+            f++;
+        if (!antes(&sim.eventos[f], &ultimo))
+            break;
+        sim.eventos[i] = sim.eventos[f];
+        i = f;
+    }
+    sim.eventos[i] = ultimo;
+    return topo;
+}
+
+static Pacote *pacote_aloca(void)
+{
+    Pacote *p = sim.livres;
+    if (p)
+        sim.livres = p->proximo;
+    else if (!(p = malloc(sizeof(Pacote))))
+    {
+        fprintf(stderr, "Simulacao sem memoria\n");
+        exit(1);
+    }
+    p->proximo = NULL;
+    return p;
+}
+
+static void pacote_solta(Pacote *p)
+{
+    p->proximo = sim.livres;
+    sim.livres = p;
+}
+
+// mistura um evento no resumo da execucao (FNV-1a)
+static void rastreia(long long valor)
+{
+    for (int i = 0; i < 8; i++)
+    {
+        sim.rastro ^= (valor >> (8 * i)) & 0xff;
+        sim.rastro *= 0x100000001B3ULL;
+    }
+}
+
+static void inicia_no(void)
+{
+    No *no = sim.nos[sim.atual];
+    no->corpo(no->arg);
+    no->vivo = 0;
+    sim.vivos--;
+}
+
+// roda o no ate ele esperar ou terminar
+static void retoma(int i)
+{
+    sim.atual = i;
+    swapcontext(&sim.principal, &sim.nos[i]->contexto);
+    sim.atual = -1;
+    if (!sim.nos[i]->vivo)
+    {
+        free(sim.nos[i]->pilha);
+        sim.nos[i]->pilha = NULL;
+    }
+}
+
+// devolve o controle ao escalonador
+static void cede(void)
+{
+    swapcontext(&sim.nos[sim.atual]->contexto, &sim.principal);
+}
+
+// retorna -1 se a biblioteca foi compilada sem os ganchos (make SIMULACAO=1)
+int sim_inicia(uint64_t semente)
+{
+    if (!SIMULACAO_ATIVA)
+        return -1;
+    sim_termina();
+    sim.semente = semente;
+    sim.rastro = 0xCBF29CE484222325ULL;
+    return 0;
+}
+
+// cria um no que roda corpo(arg) a partir do instante atual, retorna o seu indice
+int sim_no(void (*corpo)(void *), void *arg)
+{
+    if (sim.n_nos == sim.cap_nos)
+        sim.nos = cresce(sim.nos, &sim.cap_nos, sizeof(No *));
+    No *no = calloc(1, sizeof(No));
+    if (!no || !(no->pilha = malloc(SIM_PILHA)))
+    {
+        fprintf(stderr, "Simulacao sem memoria\n");
+        exit(1);
+    }
+    no->corpo = corpo;
+    no->arg = arg;
+    no->vivo = 1;
+    no->esperando = -1;
+    getcontext(&no->contexto);
+    no->contexto.uc_stack.ss_sp = no->pilha;
+    no->contexto.uc_stack.ss_size = SIM_PILHA;
+    no->contexto.uc_link = &sim.principal;
+    makecontext(&no->contexto, inicia_no, 0);
+    int i = sim.n_nos++;
+    sim.nos[i] = no;
+    sim.vivos++;
+    agenda(EVENTO_ACORDA, sim.agora, i, 0, NULL);
+    return i;
+}
+
+// socket simulado do no, com o MAC que vai como origem dos seus frames
+int sim_socket_cria(int no, const uchar *mac)
+{
+    if (sim.n_sockets == sim.cap_sockets)
+        sim.sockets = cresce(sim.sockets, &sim.cap_sockets, sizeof(Socket));
+    Socket *s = &sim.sockets[sim.n_sockets];
+    memset(s, 0, sizeof(*s));
+    s->no = no;
+    memcpy(s->mac, mac, 6);
+    s->par = -1;
+    return SIM_SOCKET_BASE + sim.n_sockets++;
+}
+
+// liga dois sockets por um enlace, com um SimEnlace para cada sentido
+void sim_liga(int a, int b, const SimEnlace *ida, const SimEnlace *volta)
+{
+    soquete(a)->par = b;
+    soquete(a)->saida = *ida;
+    soquete(b)->par = a;
+    soquete(b)->saida = *volta;
+}
+
+// processa eventos ate todos os nos terminarem, a fila esvaziar ou o relogio passar de limite_ns
+// retorna quantos nos ficaram vivos
+int sim_roda(long long limite_ns)
+{
+#if SIMULACAO_ATIVA
+    sim_rodando = 1;
+#endif
+    while (sim.vivos > 0 && sim.n_eventos > 0 && sim.eventos[0].tempo <= limite_ns)
+    {
+        Evento e = retira();
+        sim.agora = e.tempo;
+        sim.contagem.eventos++;
+        if (e.tipo == EVENTO_ACORDA)
+        {
+            if (sim.nos[e.alvo]->vivo && e.geracao == sim.nos[e.alvo]->geracao)
+                retoma(e.alvo);
+            continue;
+        }
+
+        Socket *s = soquete(e.alvo);
+        if (s->fim)
+            s->fim->proximo = e.pacote;
+        else
+            s->fila = e.pacote;
+        s->fim = e.pacote;
+        sim.contagem.entregues++;
+        rastreia(e.tempo);
+        rastreia(e.alvo);
+        rastreia(e.pacote->tamanho);
+
+        // o frame acorda o no que espera por ele; o prazo agendado perde a validade
+        No *no = sim.nos[s->no];
+        if (no->vivo && no->esperando == e.alvo)
+        {
+            no->geracao++;
+            retoma(s->no);
+        }
+    }
+#if SIMULACAO_ATIVA
+    sim_rodando = 0;
+#endif
+    return sim.vivos;
+}
+
+// solta nos, sockets e frames; sim_inicia comeca outra execucao do zero
+void sim_termina(void)
+{
+    for (int i = 0; i < sim.n_nos; i++)
+    {
+        free(sim.nos[i]->pilha);
+        free(sim.nos[i]);
+    }
+    for (int i = 0; i < sim.n_sockets; i++)
+        while (sim.sockets[i].fila)
+        {
+            Pacote *p = sim.sockets[i].fila;
+            sim.sockets[i].fila = p->proximo;
+            free(p);
+        }
+    for (int i = 0; i < sim.n_eventos; i++)
+        free(sim.eventos[i].pacote);
+    while (sim.livres)
+    {
+        Pacote *p = sim.livres;
+        sim.livres = p->proximo;
+        free(p);
+    }
+    free(sim.nos);
+    free(sim.sockets);
+    free(sim.eventos);
+    memset(&sim, 0, sizeof(sim));
+    sim.atual = -1;
+}
+
+long long sim_agora_ns(void)
+{
+    return sim.agora;
+}
+
+// estado dos sorteios da execucao, para os nos sortearem da mesma semente
+uint64_t *sim_semente(void)
+{
+    return &sim.semente;
+}
+
+// resumo das entregas (instante, socket, tamanho): duas execucoes com a mesma semente dao o mesmo
+uint64_t sim_rastro(void)
+{
+    return sim.rastro;
+}
+
+void sim_contagem(SimContagem *c)
+{
+    *c = sim.contagem;
+}
+
+// envio: o frame sai depois do anterior na taxa do enlace, e chega apos o atraso, se nao se perder
+int sim_envia(int sock, BufferFrame *b)
+{
+    Socket *s = soquete(sock);
+    int n = buffer_total(b);
+    memcpy(buffer_mac_origem(b), s->mac, 6);
+    sim.contagem.enviados++;
+    if (s->par < 0)
+        return 0; // sem enlace, o frame some
+
+    long long inicio = s->livre_ns > sim.agora ? s->livre_ns : sim.agora;
+    s->livre_ns = inicio + (s->saida.taxa > 0 ? (long long)(n * 1e9 / s->saida.taxa) : 0);
+    if (s->saida.perda > 0 && sorteio_fracao(&sim.semente) < s->saida.perda)
+    {
+        sim.contagem.perdidos++;
+        return 0;
+    }
+
+    Pacote *p = pacote_aloca();
+    memcpy(p->dados, b->rede, n);
+    p->tamanho = n;
+    // um byte trocado depois do marcador: o checksum pega, ou o tamanho deixa de bater
+    if (s->saida.corrupcao > 0 && sorteio_fracao(&sim.semente) < s->saida.corrupcao)
+    {
+        p->dados[TAMANHO_ETH + 1 + sorteio_ate(&sim.semente, n - TAMANHO_ETH - 1)] ^=
+            1 + sorteio_ate(&sim.semente, 255);
+        sim.contagem.corrompidos++;
+    }
+
+    long long chegada = s->livre_ns + s->saida.atraso_ns;
+    if (s->saida.variacao_ns > 0)
+        chegada += sorteio_ate(&sim.semente, s->saida.variacao_ns);
+    if (chegada < s->chegada_ns)
+        chegada = s->chegada_ns;
+    s->chegada_ns = chegada;
+    agenda(EVENTO_ENTREGA, chegada, s->par, 0, p);
+    return 0;
+}
+
+// recepcao: o primeiro frame da fila num buffer do pool; sem buffer livre o frame se perde
+BufferFrame *sim_recebe(int sock, int *tamanho)
+{
+    Socket *s = soquete(sock);
+    Pacote *p = s->fila;
+    if (!p)
+        return NULL;
+    s->fila = p->proximo;
+    if (!s->fila)
+        s->fim = NULL;
+    BufferFrame *b = buffer_aloca();
+    if (b)
+    {
+        memcpy(b->rede, p->dados, p->tamanho);
+        b->chegada_ns = 0;
+        b->chegada_hw_ns = 0;
+        *tamanho = p->tamanho;
+    }
+    else
+    {
+        sim.contagem.perdidos++;
+    }
+    pacote_solta(p);
+    return b;
+}
+
+// espera_dados: o no dorme ate um frame chegar no socket ou o prazo acabar
+int sim_espera(int sock, long long timeout_ms)
+{
+    if (soquete(sock)->fila || timeout_ms <= 0 || sim.atual < 0)
+        return soquete(sock)->fila != NULL;
+    No *no = sim.nos[sim.atual];
+    no->esperando = sock;
+    agenda(EVENTO_ACORDA, sim.agora + timeout_ms * 1000000LL, sim.atual, ++no->geracao, NULL);
+    cede();
+    no->esperando = -1;
+    return soquete(sock)->fila != NULL;
+}
+
+// ritmo_espera: o no dorme 'ns' no relogio virtual
+void sim_dorme(long long ns)
+{
+    if (sim.atual < 0)
+        return;
+    No *no = sim.nos[sim.atual];
+    agenda(EVENTO_ACORDA, sim.agora + ns, sim.atual, ++no->geracao, NULL);
+    cede();
+}
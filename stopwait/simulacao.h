@@ -0,0 +1,68 @@
+#ifndef SIMULACAO_H
+#define SIMULACAO_H
+
+#include <stdint.h>
+#include "protocolo.h"
+#include "buffer.h"
+
+// simulacao de eventos discretos: varios clientes e servidores num processo so, pelos
+// mesmos enviar_com_ack/receber_com_ack, num relogio virtual que salta de evento em evento
+// cada no e uma corrotina (ucontext) que roda ate esperar: por dados (espera_dados), pelo
+// ritmo (ritmo_espera) ou ate terminar; o escalonador avanca o relogio ate o proximo evento
+// os enlaces sao simulados, com atraso, variacao, taxa, perda e corrupcao sorteados de uma
+// semente: a mesma semente da a mesma execucao, evento por evento (sim_rastro)
+// make SIMULACAO=1 compila a biblioteca com os ganchos (timestamp_*, espera_dados, envio,
+// recepcao e ritmo); sem ele os ganchos somem e a biblioteca fica como sempre foi
+
+#ifndef SIMULACAO_ATIVA
+#define SIMULACAO_ATIVA 0
+#endif
+
+#define SIM_SOCKET_BASE (1 << 24) // sockets simulados, acima de qualquer descritor real
+#define SIM_PILHA (128 * 1024)     // pilha de cada no
+
+// um sentido de um enlace simulado
+typedef struct {
+    long long atraso_ns;   // propagacao
+    long long variacao_ns; // somada ao atraso, sorteada em [0, variacao), sem reordenar
+    double taxa;           // bytes por segundo, 0 sem limite
+    double perda;          // probabilidade de um frame sumir
+    double corrupcao;      // probabilidade de um byte do frame chegar trocado
+} SimEnlace;
+
+// contadores da execucao
+typedef struct {
+    long long enviados;
+    long long perdidos;
+    long long corrompidos;
+    long long entregues;
+    long long eventos;
+} SimContagem;
+
+#if SIMULACAO_ATIVA
+extern int sim_rodando; // dentro de sim_roda, o relogio e o virtual
+static inline int sim_socket(int sock) { return sock >= SIM_SOCKET_BASE; }
+#else
+#define sim_rodando 0
+static inline int sim_socket(int sock) { (void)sock; return 0; }
+#endif
+
+int sim_inicia(uint64_t semente);
+int sim_no(void (*corpo)(void *), void *arg);
+int sim_socket_cria(int no, const uchar *mac);
+void sim_liga(int a, int b, const SimEnlace *ida, const SimEnlace *volta);
+int sim_roda(long long limite_ns);
+void sim_termina(void);
+
+long long sim_agora_ns(void);
+uint64_t *sim_semente(void);
+uint64_t sim_rastro(void);
+void sim_contagem(SimContagem *c);
+
+// ganchos da biblioteca
+int sim_envia(int sock, BufferFrame *b);
+BufferFrame *sim_recebe(int sock, int *tamanho);
+int sim_espera(int sock, long long timeout_ms);
+void sim_dorme(long long ns);
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef SORTEIO_H
+#define SORTEIO_H
+
+#include <stdint.h>
+
+// sorteios reproduziveis (splitmix64): o estado e de quem sorteia, a mesma semente da a
+// mesma sequencia em qualquer maquina, sem o estado global do rand()
+
+static inline uint64_t sorteio_proximo(uint64_t *estado)
+{
+    uint64_t z = (*estado += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// inteiro em [0, n)
+static inline uint64_t sorteio_ate(uint64_t *estado, uint64_t n)
+{
+    return sorteio_proximo(estado) % n;
+}
+
+// fracao em [0, 1)
+static inline double sorteio_fracao(uint64_t *estado)
+{
+    return (sorteio_proximo(estado) >> 11) * 0x1.0p-53;
+}
+
+#endif
@@ -0,0 +1,513 @@
+#include "uring.h"
+#include "carimbo.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+// operacao de cada submissao, no user_data junto com o indice do buffer
+#define OP_RECEBE 1
+#define OP_ENVIO 2
+#define OP_LEITURA 3
+#define OP_ESCRITA 4
+#define USER_DATA(op, b) (((unsigned long long)(op) << 16) | (unsigned)buffer_indice(b))
+
+static struct
+{
+    int fd;
+    int sock; // socket servido pelo anel, -1 se desligado
+
+    // fila de submissao, compartilhada com o kernel
+    unsigned *sq_head, *sq_tail, *sq_mascara, *sq_indices;
+    struct io_uring_sqe *sqes;
+    unsigned sq_entradas;
+    unsigned sq_local; // tail ainda nao publicado
+    void *sq_mapa;
+    size_t sq_tamanho;
+    size_t sqes_tamanho;
+
+    // fila de conclusao
+    unsigned *cq_head, *cq_tail, *cq_mascara;
+    struct io_uring_cqe *cqes;
+    void *cq_mapa;
+    size_t cq_tamanho;
+
+    // buffers do pool que o kernel usa para a recepcao
+    struct io_uring_buf_ring *providos;
+    unsigned short providos_tail;
+    int entregues;
+    int recebendo; // ha um recv armado
+    int multishot; // cai para recv simples se o kernel nao aceitar
+    struct msghdr recepcao; // so os tamanhos: nome e controle vao no buffer, antes do frame
+
+    // frames recebidos, na ordem de chegada
+    int fila[MAX_BUFFERS];
+    int fila_tamanho[MAX_BUFFERS];
+    unsigned fila_ini, fila_fim;
+
+    // envios que pedem carimbo, vivos ate a conclusao
+    struct {
+        struct msghdr msg;
+        struct iovec iov;
+        uchar controle[CONTROLE_CARIMBO];
+    } envios[MAX_BUFFERS];
+
+    int lote;
+    int lendo[MAX_BUFFERS];
+    int lido[MAX_BUFFERS];
+    int escritas;
+    int erro_escrita;
+} anel = {.fd = -1, .sock = -1};
+
+static int io_uring_setup(unsigned entradas, struct io_uring_params *p)
+{
+    return (int)syscall(__NR_io_uring_setup, entradas, p);
+}
+
+static int io_uring_enter(unsigned submeter, unsigned minimo, unsigned flags, void *arg, size_t tamanho)
+{
+    return (int)syscall(__NR_io_uring_enter, anel.fd, submeter, minimo, flags, arg, tamanho);
+}
+
+static int io_uring_register(unsigned op, void *arg, unsigned n)
+{
+    return (int)syscall(__NR_io_uring_register, anel.fd, op, arg, n);
+}
+
+// publica o que foi preparado e, se 'minimo', espera conclusoes ate o prazo (negativo = sem prazo)
+static void entra(unsigned minimo, long long timeout_ns)
+{
+    unsigned submeter = anel.sq_local - __atomic_load_n(anel.sq_head, __ATOMIC_ACQUIRE);
+    __atomic_store_n(anel.sq_tail, anel.sq_local, __ATOMIC_RELEASE);
+    if (submeter == 0 && minimo == 0)
+        return;
+
+    unsigned flags = minimo ? IORING_ENTER_GETEVENTS : 0;
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg = {0};
+    void *parg = NULL;
+    size_t tamanho = 0;
+    if (minimo && timeout_ns >= 0)
+    {
+        ts.tv_sec = timeout_ns / 1000000000LL;
+        ts.tv_nsec = timeout_ns % 1000000000LL;
+        arg.sigmask_sz = _NSIG / 8;
+        arg.ts = (uintptr_t)&ts;
+        flags |= IORING_ENTER_EXT_ARG;
+        parg = &arg;
+        tamanho = sizeof(arg);
+    }
+    if (io_uring_enter(submeter, minimo, flags, parg, tamanho) < 0 && errno != ETIME && errno != EINTR)
+        perror("Erro no io_uring_enter");
+}
+
+// proxima entrada livre da fila de submissao, zerada
+static struct io_uring_sqe *pega_sqe(void)
+{
+    if (anel.sq_local - __atomic_load_n(anel.sq_head, __ATOMIC_ACQUIRE) >= anel.sq_entradas)
+    {
+        entra(0, -1); // fila cheia, manda o lote atual
+        if (anel.sq_local - __atomic_load_n(anel.sq_head, __ATOMIC_ACQUIRE) >= anel.sq_entradas)
+            return NULL;
+    }
+    unsigned i = anel.sq_local++ & *anel.sq_mascara;
+    anel.sq_indices[i] = i;
+    memset(&anel.sqes[i], 0, sizeof(anel.sqes[i]));
+    return &anel.sqes[i];
+}
+
+// recepcao sobre o grupo de buffers providos; no modo multishot continua armada a cada frame
+// e o recvmsg escreve cabecalho e controle (carimbos) em b->recepcao, o frame cai em b->rede
+static void arma_recepcao(void)
+{
+    struct io_uring_sqe *sqe = pega_sqe();
+    if (!sqe)
+        return;
+    sqe->fd = anel.sock;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = GRUPO_RECEPCAO;
+    if (anel.multishot)
+    {
+        anel.recepcao.msg_controllen = ESPACO_RECEPCAO - sizeof(struct io_uring_recvmsg_out);
+        sqe->opcode = IORING_OP_RECVMSG;
+        sqe->addr = (uintptr_t)&anel.recepcao;
+        sqe->len = 1;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+    }
+    else
+    {
+        sqe->opcode = IORING_OP_RECV;
+    }
+    sqe->user_data = (unsigned long long)OP_RECEBE << 16;
+    anel.recebendo = 1;
+    entra(0, -1);
+}
+
+// completa os buffers do kernel com buffers livres do pool e rearma a recepcao
+static void repoe_recepcao(void)
+{
+    int antes = anel.entregues;
+    BufferFrame *b;
+    while (anel.entregues < ENTRADAS_RECEPCAO && (b = buffer_aloca()) != NULL)
+    {
+        struct io_uring_buf *e = &anel.providos->bufs[anel.providos_tail & (ENTRADAS_RECEPCAO - 1)];
+        e->addr = (uintptr_t)b->recepcao;
+        e->len = ESPACO_RECEPCAO + TAMANHO_BUFFER;
+        e->bid = buffer_indice(b);
+        anel.providos_tail++;
+        anel.entregues++;
+    }
+    if (anel.entregues != antes)
+        __atomic_store_n(&anel.providos->tail, anel.providos_tail, __ATOMIC_RELEASE);
+    if (!anel.recebendo && anel.entregues > 0)
+        arma_recepcao();
+}
+
+static void trata_conclusao(const struct io_uring_cqe *cqe)
+{
+    int op = cqe->user_data >> 16;
+    BufferFrame *b = buffer_pool() + (cqe->user_data & 0xFFFF);
+
+    switch (op)
+    {
+    case OP_RECEBE:
+        if (cqe->flags & IORING_CQE_F_BUFFER)
+        {
+            // o buffer volta a ser nosso, ja com a referencia que o pool deu
+            b = buffer_pool() + (cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+            anel.entregues--;
+            int tamanho = -1;
+            if (anel.multishot && cqe->res >= (int)sizeof(struct io_uring_recvmsg_out))
+            {
+                struct io_uring_recvmsg_out *saida = (struct io_uring_recvmsg_out *)b->recepcao;
+                tamanho = saida->payloadlen < TAMANHO_BUFFER ? (int)saida->payloadlen : TAMANHO_BUFFER;
+                carimbo_recepcao(b, saida + 1, saida->controllen);
+            }
+            else if (!anel.multishot && cqe->res > 0)
+            {
+                // sem multishot o frame chega no inicio do buffer provido, e sem carimbo
+                tamanho = cqe->res < TAMANHO_BUFFER ? cqe->res : TAMANHO_BUFFER;
+                memmove(b->rede, b->recepcao, tamanho);
+                carimbo_recepcao(b, NULL, 0);
+            }
+            if (tamanho > 0)
+            {
+                unsigned i = anel.fila_fim++ % MAX_BUFFERS;
+                anel.fila[i] = buffer_indice(b);
+                anel.fila_tamanho[i] = tamanho;
+            }
+            else
+                buffer_solta(b);
+        }
+        if (!(cqe->flags & IORING_CQE_F_MORE))
+        {
+            anel.recebendo = 0;
+            if (cqe->res == -EINVAL && anel.multishot)
+                anel.multishot = 0;
+        }
+        break;
+    case OP_ENVIO:
+        if (cqe->res < 0)
+        {
+            errno = -cqe->res;
+            perror("Erro ao enviar frame");
+        }
+        buffer_solta(b);
+        break;
+    case OP_LEITURA:
+        anel.lido[buffer_indice(b)] = cqe->res;
+        anel.lendo[buffer_indice(b)] = 0;
+        buffer_solta(b);
+        break;
+    case OP_ESCRITA:
+        // uma escrita curta deixaria um buraco no arquivo, conta como erro
+        if (cqe->res < 0)
+            anel.erro_escrita = -cqe->res;
+        else if (cqe->res < (int)buffer_tamanho(b))
+            anel.erro_escrita = EIO;
+        anel.escritas--;
+        buffer_solta(b);
+        break;
+    }
+}
+
+// consome todas as conclusoes disponiveis, sem entrar no kernel
+static void colhe(void)
+{
+    unsigned head = *anel.cq_head;
+    unsigned tail = __atomic_load_n(anel.cq_tail, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++)
+        trata_conclusao(&anel.cqes[head & *anel.cq_mascara]);
+    __atomic_store_n(anel.cq_head, head, __ATOMIC_RELEASE);
+    repoe_recepcao();
+}
+
+// cria o anel para o socket, registra o pool e arma a recepcao multishot
+// retorna 0 se o backend ficou ativo, -1 se o kernel nao suporta (nada muda)
+int uring_inicia(int sock)
+{
+    struct io_uring_params p = {0};
+    anel.fd = io_uring_setup(ENTRADAS_ANEL, &p);
+    if (anel.fd < 0)
+        return -1;
+    if (!(p.features & IORING_FEAT_EXT_ARG))
+    {
+        uring_termina();
+        return -1;
+    }
+
+    // mapeia as filas de submissao e de conclusao
+    anel.sq_tamanho = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    anel.cq_tamanho = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    anel.sqes_tamanho = p.sq_entries * sizeof(struct io_uring_sqe);
+    anel.sq_mapa = mmap(NULL, anel.sq_tamanho, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        anel.fd, IORING_OFF_SQ_RING);
+    anel.cq_mapa = mmap(NULL, anel.cq_tamanho, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        anel.fd, IORING_OFF_CQ_RING);
+    anel.sqes = mmap(NULL, anel.sqes_tamanho, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     anel.fd, IORING_OFF_SQES);
+    if (anel.sq_mapa == MAP_FAILED || anel.cq_mapa == MAP_FAILED || anel.sqes == MAP_FAILED)
+    {
+        uring_termina();
+        return -1;
+    }
+    char *sq = anel.sq_mapa, *cq = anel.cq_mapa;
+    anel.sq_head = (unsigned *)(sq + p.sq_off.head);
+    anel.sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    anel.sq_mascara = (unsigned *)(sq + p.sq_off.ring_mask);
+    anel.sq_indices = (unsigned *)(sq + p.sq_off.array);
+    anel.sq_entradas = p.sq_entries;
+    anel.sq_local = *anel.sq_tail;
+    anel.cq_head = (unsigned *)(cq + p.cq_off.head);
+    anel.cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    anel.cq_mascara = (unsigned *)(cq + p.cq_off.ring_mask);
+    anel.cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+    // o pool inteiro vira um unico buffer fixo, para as leituras e escritas de arquivo
+    struct iovec iov = {buffer_pool(), MAX_BUFFERS * sizeof(BufferFrame)};
+    if (io_uring_register(IORING_REGISTER_BUFFERS, &iov, 1) < 0)
+    {
+        uring_termina();
+        return -1;
+    }
+
+    // anel de buffers providos, de onde o kernel tira um buffer a cada frame recebido
+    anel.providos = mmap(NULL, ENTRADAS_RECEPCAO * sizeof(struct io_uring_buf), PROT_READ | PROT_WRITE,
+                         MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if (anel.providos == MAP_FAILED)
+    {
+        anel.providos = NULL;
+        uring_termina();
+        return -1;
+    }
+    struct io_uring_buf_reg reg = {0};
+    reg.ring_addr = (uintptr_t)anel.providos;
+    reg.ring_entries = ENTRADAS_RECEPCAO;
+    reg.bgid = GRUPO_RECEPCAO;
+    if (io_uring_register(IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+    {
+        uring_termina();
+        return -1;
+    }
+
+    anel.sock = sock;
+    anel.multishot = 1;
+    repoe_recepcao();
+    return 0;
+}
+
+// fecha o anel; os buffers que estavam com o kernel nao voltam ao pool
+void uring_termina(void)
+{
+    if (anel.fd >= 0)
+        close(anel.fd);
+    if (anel.sq_mapa && anel.sq_mapa != MAP_FAILED)
+        munmap(anel.sq_mapa, anel.sq_tamanho);
+    if (anel.cq_mapa && anel.cq_mapa != MAP_FAILED)
+        munmap(anel.cq_mapa, anel.cq_tamanho);
+    if (anel.sqes && anel.sqes != MAP_FAILED)
+        munmap(anel.sqes, anel.sqes_tamanho);
+    if (anel.providos)
+        munmap(anel.providos, ENTRADAS_RECEPCAO * sizeof(struct io_uring_buf));
+    memset(&anel, 0, sizeof(anel));
+    anel.fd = -1;
+    anel.sock = -1;
+}
+
+int uring_ativo(int sock)
+{
+    return sock >= 0 && sock == anel.sock;
+}
+
+int uring_fd(void)
+{
+    return anel.fd;
+}
+
+// espera ate haver frame recebido, retorna 1 se ha, 0 se o prazo acabou
+int uring_espera(int sock, long long timeout_ms)
+{
+    (void)sock;
+    long long fim = timestamp_ns() + timeout_ms * 1000000LL;
+    colhe();
+    while (anel.fila_ini == anel.fila_fim)
+    {
+        long long resta = fim - timestamp_ns();
+        if (resta <= 0)
+            return 0;
+        entra(1, resta);
+        colhe();
+    }
+    return 1;
+}
+
+// consulta sem dormir: manda o lote pendente, deixa o kernel entregar o que ja chegou e colhe
+// retorna 1 se ha frame recebido
+int uring_consulta(int sock)
+{
+    (void)sock;
+    colhe();
+    if (anel.fila_ini == anel.fila_fim)
+    {
+        unsigned submeter = anel.sq_local - __atomic_load_n(anel.sq_head, __ATOMIC_ACQUIRE);
+        __atomic_store_n(anel.sq_tail, anel.sq_local, __ATOMIC_RELEASE);
+        io_uring_enter(submeter, 0, IORING_ENTER_GETEVENTS, NULL, 0);
+        colhe();
+    }
+    return anel.fila_ini != anel.fila_fim;
+}
+
+// proximo frame recebido, com quantos bytes chegaram, ou NULL se nao ha
+BufferFrame *uring_recebe(int sock, int *tamanho)
+{
+    (void)sock;
+    if (anel.fila_ini == anel.fila_fim)
+        colhe();
+    if (anel.fila_ini == anel.fila_fim)
+        return NULL;
+    unsigned i = anel.fila_ini++ % MAX_BUFFERS;
+    *tamanho = anel.fila_tamanho[i];
+    return buffer_pool() + anel.fila[i];
+}
+
+int uring_pendentes(int sock)
+{
+    return uring_ativo(sock) ? (int)(anel.fila_fim - anel.fila_ini) : 0;
+}
+
+// enfileira o envio do frame; o anel segura uma referencia ate a conclusao
+// com 'carimbar' vai como sendmsg, pedindo o carimbo de envio (carimbo.h)
+int uring_envia(int sock, BufferFrame *b, int carimbar)
+{
+    struct io_uring_sqe *sqe = pega_sqe();
+    if (!sqe)
+        return -1;
+    sqe->fd = sock;
+    if (carimbar)
+    {
+        int i = buffer_indice(b);
+        anel.envios[i].iov.iov_base = b->rede;
+        anel.envios[i].iov.iov_len = buffer_total(b);
+        memset(&anel.envios[i].msg, 0, sizeof(anel.envios[i].msg));
+        anel.envios[i].msg.msg_iov = &anel.envios[i].iov;
+        anel.envios[i].msg.msg_iovlen = 1;
+        anel.envios[i].msg.msg_control = anel.envios[i].controle;
+        anel.envios[i].msg.msg_controllen = carimbo_controle(anel.envios[i].controle);
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->addr = (uintptr_t)&anel.envios[i].msg;
+        sqe->len = 1;
+    }
+    else
+    {
+        sqe->opcode = IORING_OP_SEND;
+        sqe->addr = (uintptr_t)b->rede;
+        sqe->len = buffer_total(b);
+    }
+    sqe->user_data = USER_DATA(OP_ENVIO, b);
+    buffer_ref(b);
+    if (!anel.lote)
+        entra(0, -1);
+    return 0;
+}
+
+void uring_lote(int ligado)
+{
+    anel.lote = ligado;
+    if (!ligado && anel.fd >= 0)
+        entra(0, -1);
+}
+
+// le 'tamanho' bytes do arquivo em buffer_dados(b); a leitura segue enquanto o chamador trabalha
+int uring_le(int fd, BufferFrame *b, long long posicao, int tamanho)
+{
+    struct io_uring_sqe *sqe = pega_sqe();
+    if (!sqe)
+        return -1;
+    sqe->opcode = IORING_OP_READ_FIXED;
+    sqe->fd = fd;
+    sqe->addr = (uintptr_t)buffer_dados(b);
+    sqe->len = tamanho;
+    sqe->off = posicao;
+    sqe->buf_index = 0;
+    sqe->user_data = USER_DATA(OP_LEITURA, b);
+    buffer_ref(b);
+    anel.lendo[buffer_indice(b)] = 1;
+    entra(0, -1);
+    return 0;
+}
+
+// espera a leitura submetida para b, retorna os bytes lidos ou -1
+int uring_espera_leitura(BufferFrame *b)
+{
+    colhe();
+    while (anel.lendo[buffer_indice(b)])
+    {
+        entra(1, -1);
+        colhe();
+    }
+    return anel.lido[buffer_indice(b)] < 0 ? -1 : anel.lido[buffer_indice(b)];
+}
+
+// grava o payload de b no arquivo; vai ao kernel junto com a proxima espera do socket
+int uring_escreve(int fd, BufferFrame *b, long long posicao)
+{
+    struct io_uring_sqe *sqe = pega_sqe();
+    if (!sqe)
+        return -1;
+    sqe->opcode = IORING_OP_WRITE_FIXED;
+    sqe->fd = fd;
+    sqe->addr = (uintptr_t)buffer_dados(b);
+    sqe->len = buffer_tamanho(b);
+    sqe->off = posicao;
+    sqe->buf_index = 0;
+    sqe->user_data = USER_DATA(OP_ESCRITA, b);
+    buffer_ref(b);
+    anel.escritas++;
+    return 0;
+}
+
+// espera todas as escritas pendentes, retorna -1 se alguma falhou
+int uring_espera_escritas(void)
+{
+    colhe();
+    while (anel.escritas > 0)
+    {
+        entra(1, -1);
+        colhe();
+    }
+    int erro = anel.erro_escrita;
+    anel.erro_escrita = 0;
+    if (erro)
+    {
+        errno = erro;
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,33 @@
+#ifndef URING_H
+#define URING_H
+
+#include "protocolo.h"
+#include "buffer.h"
+
+#define ENTRADAS_ANEL 64      // submissoes na fila do io_uring
+#define ENTRADAS_RECEPCAO 32  // buffers do pool entregues ao kernel para a recepcao (potencia de 2)
+#define GRUPO_RECEPCAO 0      // id do grupo de buffers providos
+
+// backend de E/S com io_uring: recepcao multishot e envios em lote no socket,
+// leitura e escrita dos objetos no mesmo anel, tudo sobre o pool de buffers registrado
+// sem suporte no kernel uring_inicia falha e o protocolo segue com send/recv
+int uring_inicia(int sock);
+void uring_termina(void);
+int uring_ativo(int sock);
+int uring_fd(void); // pronto para leitura quando ha conclusoes, para o epoll
+
+// socket
+int uring_espera(int sock, long long timeout_ms);
+int uring_consulta(int sock); // sem dormir, para o modo de giro (giro.h)
+BufferFrame *uring_recebe(int sock, int *tamanho);
+int uring_pendentes(int sock); // frames ja colhidos, que nao acordam mais o epoll
+int uring_envia(int sock, BufferFrame *b, int carimbar);
+void uring_lote(int ligado); // enquanto ligado, os envios so vao ao kernel ao desligar
+
+// arquivos, direto em buffer_dados(b)
+int uring_le(int fd, BufferFrame *b, long long posicao, int tamanho);
+int uring_espera_leitura(BufferFrame *b);
+int uring_escreve(int fd, BufferFrame *b, long long posicao);
+int uring_espera_escritas(void);
+
+#endif